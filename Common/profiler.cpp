@@ -0,0 +1,126 @@
+#include "profiler.hpp"
+#include <fstream>
+#include <mutex>
+#include <memory>
+#include <map>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+
+namespace {
+	struct ThreadBuffer {
+		int threadId = 0;
+		std::vector<Profiler::Event> events = std::vector<Profiler::Event>(Profiler::ringSize);
+		//total number of events ever recorded, the ring holds the last ringSize
+		size_t head = 0;
+		//head at the last collectTotals
+		size_t collected = 0;
+		//only contended while someone is reading the buffer
+		std::mutex mutex;
+	};
+
+	struct Registry {
+		std::mutex mutex;
+		//never freed, so events survive the thread that recorded them
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	};
+
+	Registry& registry() {
+		static Registry r;
+		return r;
+	}
+
+	ThreadBuffer& threadBuffer() {
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr) {
+			auto& r = registry();
+			std::lock_guard lock(r.mutex);
+			r.buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffer = r.buffers.back().get();
+			buffer->threadId = int(r.buffers.size()) - 1;
+		}
+		return *buffer;
+	}
+}
+
+void Profiler::record(const char* name, Clock::time_point start, Clock::time_point end)
+{
+	auto& buffer = threadBuffer();
+
+	Event e;
+	e.name = name;
+	e.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+	e.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	std::lock_guard lock(buffer.mutex);
+	buffer.events[buffer.head % ringSize] = e;
+	buffer.head++;
+}
+
+std::vector<std::pair<std::string, double>> Profiler::collectTotals()
+{
+	//the same literal can have different addresses in different translation units
+	std::map<std::string, double> totals;
+
+	auto& r = registry();
+	std::lock_guard lock(r.mutex);
+	for (auto& buffer : r.buffers) {
+		std::lock_guard bufferLock(buffer->mutex);
+		size_t first = std::max(buffer->collected, buffer->head > ringSize ? buffer->head - ringSize : 0);
+		for (size_t i = first; i < buffer->head; i++) {
+			const auto& e = buffer->events[i % ringSize];
+			totals[e.name] += e.duration * 1e-9;
+		}
+		buffer->collected = buffer->head;
+	}
+
+	return { totals.begin(), totals.end() };
+}
+
+bool Profiler::exportChromeTrace(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+
+	auto& r = registry();
+	std::lock_guard lock(r.mutex);
+	//the trace starts at the earliest event still kept, the scopes record in the order they end
+	long long origin = std::numeric_limits<long long>::max();
+	for (auto& buffer : r.buffers) {
+		std::lock_guard bufferLock(buffer->mutex);
+		size_t begin = buffer->head > ringSize ? buffer->head - ringSize : 0;
+		for (size_t i = begin; i < buffer->head; i++)
+			origin = std::min(origin, buffer->events[i % ringSize].start);
+	}
+
+	for (auto& buffer : r.buffers) {
+		std::lock_guard bufferLock(buffer->mutex);
+		size_t begin = buffer->head > ringSize ? buffer->head - ringSize : 0;
+		for (size_t i = begin; i < buffer->head; i++) {
+			const auto& e = buffer->events[i % ringSize];
+			//complete events, times in microseconds
+			file << (first ? "" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << 
+				buffer->threadId << ",\"ts\":" << (e.start - origin) / 1000.0 << ",\"dur\":" << e.duration / 1000.0 << "}";
+			first = false;
+		}
+	}
+	file << "\n]}\n";
+
+	return bool(file);
+}
+
+const char* Profiler::requestedTracePath()
+{
+	static const char* path = std::getenv("PROFILER_TRACE");
+	return path && *path ? path : nullptr;
+}
+
+bool Profiler::exportRequestedTrace()
+{
+	const char* path = requestedTracePath();
+	return path && exportChromeTrace(path);
+}
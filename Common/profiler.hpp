@@ -0,0 +1,68 @@
+#pragma once
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <utility>
+
+//low overhead instrumentation, every thread records its timings into its own ring buffer
+//the events can be summed up at runtime or exported as chrome trace json
+//(chrome://tracing or ui.perfetto.dev)
+//nothing is recorded unless the PROFILER_TRACE environment variable names the file for the trace,
+//or the app turns the profiler on for its own totals
+class Profiler {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Event {
+		//string literal
+		const char* name = nullptr;
+		//nanoseconds since the epoch of the clock, the export makes them relative to the first event
+		long long start = 0;
+		long long duration = 0;
+	};
+
+	static void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+	static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+	static void record(const char* name, Clock::time_point start, Clock::time_point end);
+	//seconds spent in each scope since the last call, summed over all threads
+	static std::vector<std::pair<std::string, double>> collectTotals();
+	static bool exportChromeTrace(const std::string& path);
+	//exports to the file given by PROFILER_TRACE, does nothing without it
+	static bool exportRequestedTrace();
+
+	//events kept per thread, older ones get overwritten
+	static constexpr size_t ringSize = 1 << 16;
+
+private:
+	//file of PROFILER_TRACE, or nullptr
+	static const char* requestedTracePath();
+	static inline std::atomic<bool> enabled_ = requestedTracePath() != nullptr;
+};
+
+class ScopedTimer {
+public:
+	ScopedTimer(const char* name)
+		: name_(name)
+	{
+		if (Profiler::isEnabled())
+			start_ = Profiler::Clock::now();
+	}
+	~ScopedTimer() {
+		if (start_ != Profiler::Clock::time_point())
+			Profiler::record(name_, start_, Profiler::Clock::now());
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	const char* name_;
+	Profiler::Clock::time_point start_;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+//times the rest of the enclosing scope, name must be a string literal
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(profileScope_, __LINE__)(name)
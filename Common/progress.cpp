@@ -0,0 +1,87 @@
+#include "progress.hpp"
+#include <iomanip>
+#include <sstream>
+
+ProgressReporter::ProgressReporter(std::string label, uint64_t total, std::ostream& out, std::chrono::milliseconds interval)
+	: label_(std::move(label)), total_(total), out_(out), interval_(interval), start_(Clock::now())
+{
+	thread_ = std::thread(&ProgressReporter::run, this);
+}
+
+ProgressReporter::~ProgressReporter()
+{
+	finish();
+}
+
+size_t ProgressReporter::threadSlot()
+{
+	static std::atomic<size_t> threads = 0;
+	thread_local size_t slot = threads.fetch_add(1, std::memory_order_relaxed);
+	return slot;
+}
+
+uint64_t ProgressReporter::getDone() const
+{
+	uint64_t done = 0;
+	for (const auto& slot : slots_)
+		done += slot.units.load(std::memory_order_relaxed);
+	return done;
+}
+
+void ProgressReporter::finish()
+{
+	{
+		std::lock_guard lock(mutex_);
+		if (isStopping_)
+			return;
+		isStopping_ = true;
+	}
+	stopped_.notify_all();
+	thread_.join();
+
+	double elapsed = std::chrono::duration<double>(Clock::now() - start_).count();
+	uint64_t done = getDone();
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(2) << label_ << ": " << done << " in " << elapsed << "s (" << 
+		std::setprecision(0) << done / std::max(elapsed, 1e-9) << "/s)\n";
+	out_ << line.str() << std::flush;
+}
+
+void ProgressReporter::run()
+{
+	std::vector<uint64_t> previous(maxSlots, 0), current(maxSlots);
+	auto last = start_;
+
+	std::unique_lock lock(mutex_);
+	while (!stopped_.wait_for(lock, interval_, [this] { return isStopping_; })) {
+		auto now = Clock::now();
+		for (size_t s = 0; s < maxSlots; s++)
+			current[s] = slots_[s].units.load(std::memory_order_relaxed);
+
+		report(previous, current, std::chrono::duration<double>(now - start_).count(), 
+			std::chrono::duration<double>(now - last).count());
+		previous.swap(current);
+		last = now;
+	}
+}
+
+void ProgressReporter::report(const std::vector<uint64_t>& previous, const std::vector<uint64_t>& current, 
+	double elapsed, double sinceLast)
+{
+	uint64_t done = 0;
+	for (uint64_t units : current)
+		done += units;
+
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(1) << label_ << ": " << 100.0 * done / std::max<uint64_t>(total_, 1) << "%";
+	//from the average rate so far, steadier than the last interval
+	if (done > 0 && done < total_)
+		line << ", " << elapsed * (total_ - done) / done << "s left";
+
+	line << std::setprecision(0) << ", per thread/s:";
+	for (size_t s = 0; s < maxSlots; s++)
+		if (current[s] > 0)
+			line << " " << (current[s] - previous[s]) / sinceLast;
+	line << "\n";
+	out_ << line.str() << std::flush;
+}
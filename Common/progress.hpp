@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//progress of a long computation: workers add the units they finish to a counter of their own thread,
+//and a reporter thread samples the counters at a fixed interval to print the total, the estimated time left
+//and the rate of every thread
+//the counters are relaxed atomics on separate cache lines, adding to them never waits on another thread
+class ProgressReporter {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	ProgressReporter(std::string label, uint64_t total, std::ostream& out = std::cout, 
+		std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+	//finishes if not done yet
+	~ProgressReporter();
+
+	ProgressReporter(const ProgressReporter&) = delete;
+	ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+	//from any thread
+	void add(uint64_t units) {
+		slots_[threadSlot() % maxSlots].units.fetch_add(units, std::memory_order_relaxed);
+	}
+	uint64_t getDone() const;
+	//stops the reporter and prints the summary
+	void finish();
+
+	//threads beyond this share counters, still correct, only the per thread rates get merged
+	static constexpr size_t maxSlots = 64;
+
+private:
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> units = 0;
+	};
+
+	//small index of the calling thread, the same for every reporter
+	static size_t threadSlot();
+	void run();
+	void report(const std::vector<uint64_t>& previous, const std::vector<uint64_t>& current, double elapsed, double sinceLast);
+
+	std::string label_;
+	uint64_t total_;
+	std::ostream& out_;
+	std::chrono::milliseconds interval_;
+	Clock::time_point start_;
+
+	std::vector<Slot> slots_ = std::vector<Slot>(maxSlots);
+	std::mutex mutex_;
+	std::condition_variable stopped_;
+	bool isStopping_ = false;
+	std::thread thread_;
+};
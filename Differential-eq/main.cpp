@@ -1,5 +1,6 @@
 ﻿#include <iostream>
 #include "pendulum.hpp"
+#include "profiler.hpp"
 
 int main() {
 	Pendulum pendulum;
@@ -39,6 +40,7 @@ int main() {
 	titles.setPosition({ 15, 8 });
 
 	while (w.isOpen()) {
+		PROFILE_SCOPE("frame");
 		while (const std::optional event = w.pollEvent()) {
 			if (event->is<sf::Event::Closed>())
 				w.close();
@@ -154,8 +156,12 @@ int main() {
 		eq.setPosition({ 15, float(w.getSize().y - 75) });
 		w.draw(eq);
 
-		w.display();
+		{
+			PROFILE_SCOPE("display");
+			w.display();
+		}
 	}
 
+	Profiler::exportRequestedTrace();
 	return 0;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "pendulum.hpp"
+#include "profiler.hpp"
 #include <iostream>
 
 Pendulum::Pendulum()
@@ -15,6 +16,7 @@ Pendulum::Pendulum()
 
 void Pendulum::update(int fps)
 {
+	PROFILE_SCOPE("Pendulum::update");
 	double dt = 1.0 / 1000.0 / fps;
 
 	for (int i = 0; i < 1000; i++) {
@@ -26,6 +28,7 @@ void Pendulum::update(int fps)
 }
 sf::Image Pendulum::renderGraph(int width, int height)
 {
+	PROFILE_SCOPE("Pendulum::renderGraph");
 	if (hasMoved) {
 		lastImg = renderAxes(width, height);
 		hasMoved = false;
@@ -2,6 +2,7 @@
 #include <SFML/Window.hpp>
 #include <iostream>
 #include "pendulum.hpp"
+#include "profiler.hpp"
 
 int main() {
 	sf::Shader glowShader;
@@ -32,6 +33,7 @@ int main() {
 	size_t ping = 0;
 
 	while (window.isOpen()) {
+		PROFILE_SCOPE("frame");
 		while (const std::optional event = window.pollEvent()) {
 			if (event->is<sf::Event::Closed>())
 				window.close();
@@ -130,7 +132,10 @@ int main() {
 		window.draw(dot1);
 		window.draw(dot2);
 
-		window.display();
+		{
+			PROFILE_SCOPE("display");
+			window.display();
+		}
 		ping++;
 
 		lastState = state;
@@ -144,6 +149,8 @@ int main() {
 		}
 		
 	}
+
+	Profiler::exportRequestedTrace();
 	return 0;
 
 }
\ No newline at end of file
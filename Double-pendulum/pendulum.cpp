@@ -1,4 +1,5 @@
 #include "pendulum.hpp"
+#include "profiler.hpp"
 #include <cmath>
 
 Pendulum::Pendulum(double inM1, double inM2, double inL1, double inL2)
@@ -12,6 +13,7 @@ Pendulum::Pendulum(double inM1, double inM2, double inL1, double inL2)
 
 void Pendulum::step(double dt)
 {
+	PROFILE_SCOPE("Pendulum::step");
     auto deriv = [&](const State& st) {
         State d;
         auto acc = computeAccelerations(st);
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <SFML/Graphics.hpp>
 #include "transform.hpp"
+#include "profiler.hpp"
 
 static sf::Color getFrequencyColor(double magnitude, double maxMagnitude) {
 	// 0 ~ tip, 2 = base
@@ -100,6 +101,7 @@ int main()
 	sf::VertexArray traced(sf::PrimitiveType::LineStrip);
 
 	while (w.isOpen()) {
+		PROFILE_SCOPE("frame");
 		while (const std::optional event = w.pollEvent()) {
 			if (event->is<sf::Event::Closed>())
 				w.close();
@@ -275,11 +277,15 @@ int main()
 		spectrumSprite.scale(sf::Vector2f(1 / zoom, 1 / zoom));
 		w.draw(spectrumSprite);
 
-		w.display();
+		{
+			PROFILE_SCOPE("display");
+			w.display();
+		}
 	}
 
 	if (ft != nullptr)
 		delete ft;
 
+	Profiler::exportRequestedTrace();
 	return 0;
 }
\ No newline at end of file
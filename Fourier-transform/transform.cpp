@@ -1,33 +1,20 @@
 #include "transform.hpp"
+#include "profiler.hpp"
 #include <algorithm>
 
 Transform::Transform(const std::vector<Point>& x)
 {
+	PROFILE_SCOPE("Transform::Transform");
     if (x.size() == 0)
 		return;
 
-    const size_t N = x.size();
-    spectrum_ = std::vector<Point>(N);
-
-    const double twoPiOverN = 2.0 * PI / N;
-
-    for (size_t k = 0; k < N; k++) {
-        std::complex<double> sum(0.0, 0.0);
-
-        for (size_t n = 0; n < N; n++) {
-            double angle = -twoPiOverN * double(n * k);
-            std::complex<double> w(std::cos(angle), std::sin(angle));
-            sum += x[n] * w;
-        }
-
-        spectrum_[k] = sum;
-    }
-
+    spectrum_ = fft(x);
     orderSpectrum();
 }
 
 std::vector<Point> Transform::smoothenPoints(const std::vector<Point>& raw)
 {
+	PROFILE_SCOPE("Transform::smoothenPoints");
 	std::vector<Point> x = raw;
 	x.push_back(x[0]);
 
@@ -76,22 +63,97 @@ void Transform::orderSpectrum()
 
 std::vector<Point> Transform::performIDFT()
 {
-    const size_t N = spectrum_.size();
-    std::vector<std::complex<double>> x(N);
+    std::vector<Point> x = fft(spectrum_, true);
+    for (auto& p : x)
+        p /= double(x.size());
 
-    const double twoPiOverN = 2.0 * PI / N;
+    return x;
+}
 
-    for (size_t n = 0; n < N; n++) {
-        std::complex<double> sum(0.0, 0.0);
+//plain product, std::complex checks for infinities on every multiplication
+static inline Point multiply(const Point& a, const Point& b)
+{
+    return Point(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+std::vector<Point> Transform::fft(std::vector<Point> x, bool inverse)
+{
+    PROFILE_SCOPE("Transform::fft");
+    const size_t N = x.size();
+    if (N <= 1)
+        return x;
+
+    if ((N & (N - 1)) == 0)
+        fftRadix2(x, inverse);
+    else
+        fftBluestein(x, inverse);
+    return x;
+}
+
+void Transform::fftRadix2(std::vector<Point>& x, bool inverse)
+{
+    const size_t N = x.size();
+
+    //bit reversed order, so that the butterflies can work in place
+    for (size_t i = 1, j = 0; i < N; i++) {
+        size_t bit = N >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(x[i], x[j]);
+    }
 
-        for (size_t k = 0; k < N; k++) {
-            double angle = twoPiOverN * double(n * k);
-            std::complex<double> w(std::cos(angle), std::sin(angle));
-            sum += spectrum_[k] * w;
+    //twiddles of the last stage, a stage of length len uses every N / len th of them
+    const double sign = inverse ? 1.0 : -1.0;
+    std::vector<Point> twiddles(N / 2);
+    for (size_t k = 0; k < N / 2; k++) {
+        double angle = sign * 2.0 * PI * double(k) / double(N);
+        twiddles[k] = Point(std::cos(angle), std::sin(angle));
+    }
+
+    for (size_t len = 2; len <= N; len <<= 1) {
+        const size_t half = len / 2;
+        const size_t stride = N / len;
+        for (size_t i = 0; i < N; i += len) {
+            for (size_t k = 0; k < half; k++) {
+                Point t = multiply(x[i + k + half], twiddles[k * stride]);
+                x[i + k + half] = x[i + k] - t;
+                x[i + k] += t;
+            }
         }
+    }
+}
 
-        x[n] = sum / double(N);
+void Transform::fftBluestein(std::vector<Point>& x, bool inverse)
+{
+    const size_t N = x.size();
+    size_t M = 1;
+    while (M < 2 * N - 1)
+        M <<= 1;
+
+    //nk = (n^2 + k^2 - (k - n)^2) / 2 turns the transform into a convolution with the chirp
+    //n^2 is taken mod 2N, the angle stays small and precise for long inputs
+    const double sign = inverse ? 1.0 : -1.0;
+    std::vector<Point> chirp(N);
+    for (size_t n = 0; n < N; n++) {
+        double angle = sign * PI * double((n * n) % (2 * N)) / double(N);
+        chirp[n] = Point(std::cos(angle), std::sin(angle));
     }
 
-    return x;
+    std::vector<Point> a(M), b(M);
+    for (size_t n = 0; n < N; n++)
+        a[n] = multiply(x[n], chirp[n]);
+    b[0] = std::conj(chirp[0]);
+    for (size_t n = 1; n < N; n++)
+        b[n] = b[M - n] = std::conj(chirp[n]);
+
+    fftRadix2(a, false);
+    fftRadix2(b, false);
+    for (size_t i = 0; i < M; i++)
+        a[i] = multiply(a[i], b[i]);
+    fftRadix2(a, true);
+
+    for (size_t k = 0; k < N; k++)
+        x[k] = multiply(a[k], chirp[k]) / double(M);
 }
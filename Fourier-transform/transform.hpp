@@ -17,6 +17,8 @@ public:
 	Transform(const std::vector<Point>& x);
 
 	static std::vector<Point> smoothenPoints(const std::vector<Point>& x);
+	//unnormalized discrete fourier transform of any length, inverse flips the sign of the exponent
+	static std::vector<Point> fft(std::vector<Point> x, bool inverse = false);
 
 	std::vector<Point> spectrum_;
 	//first element is DC component, then sorted by magnitude descending
@@ -25,5 +27,9 @@ public:
 private:
 	void orderSpectrum();
 	std::vector<Point> performIDFT();
+	//in place, the size has to be a power of two
+	static void fftRadix2(std::vector<Point>& x, bool inverse);
+	//any size, as a convolution of power of two size
+	static void fftBluestein(std::vector<Point>& x, bool inverse);
 	
 };
\ No newline at end of file
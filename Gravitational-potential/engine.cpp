@@ -1,11 +1,15 @@
 #include "engine.hpp"
+#include "profiler.hpp"
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <limits>
+#include <array>
 
 Engine3D::Engine3D(unsigned int fps, unsigned int fieldSideSize, unsigned int fieldLineNum)
 	:
 	fps_(fps),
+	fieldVolume_(fieldSideSize, 16, 8),
 	fieldSideSize_(fieldSideSize),
 	fieldLineNum_(fieldLineNum)
 {
@@ -36,6 +40,7 @@ sf::RenderWindow& Engine3D::createWindow(sf::Vector2u size)
 
 int Engine3D::handleEvents()
 {
+	PROFILE_SCOPE("Engine3D::handleEvents");
 	//positive x when yaw = 0
 	Vec3 right = {
 		cos(camera_.yaw),
@@ -74,6 +79,15 @@ int Engine3D::handleEvents()
 			//toggle pause
 			if (k->code == sf::Keyboard::Key::Space)
 				status = 1;
+			//cycle through the integrators
+			else if (k->code == sf::Keyboard::Key::I)
+				status = 2;
+			//software rendered capture of the bodies
+			else if (k->code == sf::Keyboard::Key::C)
+				status = 3;
+			//switch between the field plane and the field volume
+			else if (k->code == sf::Keyboard::Key::V)
+				status = 4;
 			else if (k->code == sf::Keyboard::Key::Enter && k->alt) {
 				if (!isFullscreen_)
 					window_.create(sf::VideoMode::getFullscreenModes()[0], "Gravitational-potential", sf::State::Fullscreen, settings_);
@@ -105,126 +119,422 @@ int Engine3D::handleEvents()
 
 void Engine3D::renderPotentialField(GravitySimulator& sim)
 {
-	sf::Vector2u windowSize = window_.getSize();
-	auto addLine = [&](Vec3 p0, Vec3 p1) {
-		int steps = 1000;
-		sf::VertexArray lineArray(sf::PrimitiveType::LineStrip);
-		for (int i = 0; i <= steps; i++) {
-			double t = float(i) / steps;
-			Vec3 p = p0 * (1.0f - t) + p1 * t;
-
-			p.y -= sim.getPotentialAtPoint(p.x, p.z);
-			auto rel = transformToCameraSpace(p);
-			if (rel.z <= 0)
+	PROFILE_SCOPE("Engine3D::renderPotentialField");
+	if (fieldChunks_.empty())
+		buildFieldChunks();
+
+	//nothing to update if neither the field nor the view changed
+	const sf::Vector2u size = window_.getSize();
+	bool fieldChanged = sim.getFieldVersion() != projectedFieldVersion_;
+	bool viewChanged = !(camera_ == projectedCamera_) || f != projectedF_ || size != projectedSize_;
+	if (fieldChanged || viewChanged) {
+		projectedFieldVersion_ = sim.getFieldVersion();
+		projectedCamera_ = camera_;
+		projectedF_ = f;
+		projectedSize_ = size;
+
+		//the field lies between 0 and this height, used for chunks that werent sampled yet
+		const double maxY = -sim.getPotentialFloor();
+		std::vector<std::vector<sf::Vertex>> chunkVertices(fieldChunks_.size());
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int c = 0; c < int(fieldChunks_.size()); c++) {
+			auto& chunk = fieldChunks_[c];
+			bool isCurrent = chunk.version == sim.getFieldVersion() && !chunk.points.empty();
+			if (!isChunkVisible(chunk, isCurrent ? chunk.minY : 0.0, isCurrent ? chunk.maxY : maxY))
 				continue;
 
-			sf::Vertex v;
-			v.position = sf::Vector2f(rel.x * f / rel.z, rel.y* f / rel.z);
+			if (chunk.version != sim.getFieldVersion())
+				updateChunkCurvature(chunk, sim);
 
-			if (p0.x == p0.z) {
-				if (p0.x == p1.x)
-					v.color = sf::Color(0, 255, 255);
-				else
-					v.color = sf::Color(255, 0, 255);
+			int samples = chunkSamples(chunk);
+			if (samples == 0)
+				continue;
+			if (!isCurrent || samples != chunk.samples)
+				sampleFieldChunk(chunk, sim, samples);
+
+			//segments with an end behind the camera are dropped
+			auto& vertices = chunkVertices[c];
+			for (size_t i = 0; i + 1 < chunk.points.size(); i++) {
+				auto a = transformToCameraSpace(chunk.points[i]);
+				auto b = transformToCameraSpace(chunk.points[i + 1]);
+				if (a.z <= 0 || b.z <= 0)
+					continue;
+
+				vertices.push_back(sf::Vertex{ sf::Vector2f(a.x * f / a.z, a.y * f / a.z), chunk.colors[i] });
+				vertices.push_back(sf::Vertex{ sf::Vector2f(b.x * f / b.z, b.y * f / b.z), chunk.colors[i + 1] });
 			}
-			else {
-				double grad = 0;
-				if (p0.x == p1.x)
-					grad = sim.getGradientAtPoint(p.x, p.z).z;
-				else
-					grad = sim.getGradientAtPoint(p.x, p.z).x;
+		}
 
-				float g = std::clamp(grad / 4, -0.5, 0.5) + 0.5;
-				v.color = sf::Color(255 * (1 - g), 255 * g, 0);
-			}
+		fieldVertices_.clear();
+		for (const auto& vertices : chunkVertices)
+			for (const auto& v : vertices)
+				fieldVertices_.append(v);
+	}
+
+	window_.draw(fieldVertices_);
+}
+
+void Engine3D::renderFieldVolume(const GravitySimulator& sim)
+{
+	PROFILE_SCOPE("Engine3D::renderFieldVolume");
+	//levels at the potential of all the mass seen from 1/4, 1/8, ... of the field side
+	if (fieldVolume_.getLevels().empty()) {
+		double mass = 0.0;
+		for (const auto& b : sim.getBodies())
+			mass += b.mass;
+
+		double base = -GravitySimulator::getG() * GravitySimulator::getPotentialScaling() * mass / (fieldSideSize_ / 4.0);
+		fieldVolume_.setLevels({ base, 2 * base, 4 * base, 8 * base });
+	}
+	fieldVolume_.update(sim);
+
+	const sf::Vector2u size = window_.getSize();
+	bool volumeChanged = fieldVolume_.getVersion() != projectedVolumeVersion_;
+	bool viewChanged = !(camera_ == volumeCamera_) || f != volumeF_ || size != volumeSize_;
+	if (volumeChanged || viewChanged) {
+		projectedVolumeVersion_ = fieldVolume_.getVersion();
+		volumeCamera_ = camera_;
+		volumeF_ = f;
+		volumeSize_ = size;
+
+		//the surfaces are see-through, so they are drawn back to front
+		const auto& triangles = fieldVolume_.getTriangles();
+		const int levelNum = int(fieldVolume_.getLevels().size());
+		const Vec3 ld = lightInCameraSpace();
+		std::vector<std::pair<double, std::array<sf::Vertex, 3>>> projected(triangles.size());
+		std::vector<char> visible(triangles.size());
+
+		#pragma omp parallel for schedule(static)
+		for (int t = 0; t < int(triangles.size()); t++) {
+			const auto& tri = triangles[t];
+			Vec3 rel[3] = { transformToCameraSpace(tri.a), transformToCameraSpace(tri.b), transformToCameraSpace(tri.c) };
+			visible[t] = rel[0].z > 0 && rel[1].z > 0 && rel[2].z > 0;
+			if (!visible[t])
+				continue;
+
+			//either side of the surface can face the camera
+			Vec3 normal = (rel[1] - rel[0]).cross(rel[2] - rel[0]);
+			double len = normal.length();
+			double diff = len > 0 ? std::abs(normal.dot(ld)) / len : 0.0;
 
-			lineArray.append(v);
+			//deep levels blue, shallow levels cyan
+			float depth = levelNum > 1 ? tri.level / float(levelNum - 1) : 0.f;
+			float light = 0.3f + 0.7f * float(diff);
+			sf::Color color(std::uint8_t(40 * light), std::uint8_t(255 * (1 - depth) * light), std::uint8_t(255 * light), 90);
+
+			auto& [key, vertices] = projected[t];
+			key = rel[0].z + rel[1].z + rel[2].z;
+			for (int v = 0; v < 3; v++)
+				vertices[v] = sf::Vertex{ sf::Vector2f(rel[v].x * f / rel[v].z, rel[v].y * f / rel[v].z), color };
 		}
-		window_.draw(lineArray);
-		};
 
+		std::vector<int> order;
+		order.reserve(triangles.size());
+		for (int t = 0; t < int(triangles.size()); t++)
+			if (visible[t])
+				order.push_back(t);
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			return projected[a].first > projected[b].first;
+			});
+
+		volumeVertices_.resize(order.size() * 3);
+		for (size_t o = 0; o < order.size(); o++)
+			for (int v = 0; v < 3; v++)
+				volumeVertices_[o * 3 + v] = projected[order[o]].second[v];
+	}
+
+	window_.draw(volumeVertices_);
+}
+
+void Engine3D::buildFieldChunks()
+{
 	//the x axis is drawn cyan
 	//the z axis is drawn purple
 	double h = fieldSideSize_ / 2.0;
 	for (int i = fieldLineNum_ - 1; i >= 0; i--) {
 		double d = i * fieldSideSize_ / double(fieldLineNum_ - 1);
 
-		addLine(Vec3(-h, 0, -h + d), Vec3(h, 0, -h + d));
-		addLine(Vec3(-h + d, 0, -h), Vec3(-h + d, 0, h));
+		for (int alongZ = 0; alongZ < 2; alongZ++) {
+			Vec3 p0 = alongZ ? Vec3(-h + d, 0, -h) : Vec3(-h, 0, -h + d);
+			Vec3 p1 = alongZ ? Vec3(-h + d, 0, h) : Vec3(h, 0, -h + d);
+
+			for (int c = 0; c < chunksPerLine; c++) {
+				FieldChunk chunk;
+				chunk.p0 = p0 + (p1 - p0) * (c / double(chunksPerLine));
+				chunk.p1 = p0 + (p1 - p0) * ((c + 1) / double(chunksPerLine));
+				chunk.line = i;
+				chunk.alongZ = alongZ;
+				chunk.isAxis = p0.x == p0.z;
+				fieldChunks_.push_back(chunk);
+			}
+		}
 	}
 }
 
-void Engine3D::renderBodies(const std::vector<Body>& bodies)
+bool Engine3D::isChunkVisible(const FieldChunk& chunk, double minY, double maxY) const
 {
-	std::vector<std::pair<const Body*, Vec3>> sorted;
-	sorted.reserve(bodies.size());
-	for (auto& b : bodies) {
-		auto relPos = transformToCameraSpace(b.position);
-		if (relPos.z > 0)
-			sorted.push_back({ &b, relPos });
+	constexpr double nearZ = 0.1;
+	const double halfW = window_.getSize().x / 2.0, halfH = window_.getSize().y / 2.0;
+
+	//the box is culled only if all its corners are outside the same plane
+	int outside[5] = {};
+	for (double x : { chunk.p0.x, chunk.p1.x }) {
+		for (double y : { minY, maxY }) {
+			for (double z : { chunk.p0.z, chunk.p1.z }) {
+				auto rel = transformToCameraSpace(Vec3(x, y, z));
+				outside[0] += rel.z < nearZ;
+				outside[1] += rel.x * f < -halfW * rel.z;
+				outside[2] += rel.x * f > halfW * rel.z;
+				outside[3] += rel.y * f < -halfH * rel.z;
+				outside[4] += rel.y * f > halfH * rel.z;
+			}
+		}
 	}
 
-	std::sort(sorted.begin(), sorted.end(),
-		[](std::pair<const Body*, Vec3> a, std::pair<const Body*, Vec3> b) {
-			return a.second.z > b.second.z;
-		});
+	for (int count : outside)
+		if (count == 8)
+			return false;
+	return true;
+}
 
-	//rotate light direction vector into inverted camera space
-	double cosYaw = cos(camera_.yaw), sinYaw = sin(camera_.yaw);
-	double cosPitch = cos(camera_.pitch), sinPitch = sin(camera_.pitch);
-	auto ld = Vec3{
-		lightDirection_.x * cosYaw + lightDirection_.z * sinYaw,
-		lightDirection_.y,
-		lightDirection_.z * cosYaw - lightDirection_.x * sinYaw
-	};
-	ld = Vec3{
-		ld.x,
-		-(ld.y * cosPitch + ld.z * sinPitch),
-		ld.z * cosPitch - ld.y * sinPitch
-	}.normalized();
+int Engine3D::chunkSamples(const FieldChunk& chunk) const
+{
+	constexpr double pixelsPerSample = 2.0;
+
+	auto a = transformToCameraSpace(chunk.p0);
+	auto b = transformToCameraSpace(chunk.p1);
+	//the chunk crosses the camera plane, it could be as long as the screen
+	int wanted = std::max(chunk.curvatureSamples, maxChunkSamples / 2);
+	if (a.z > 0 && b.z > 0) {
+		//far lines are thinned out when they get too close on screen
+		double lineSpacing = fieldSideSize_ / double(fieldLineNum_ - 1) * f / std::min(a.z, b.z);
+		int stride = 1;
+		while (lineSpacing * stride < minLineSpacing && stride < fieldLineNum_)
+			stride *= 2;
+		if (chunk.line % stride != 0)
+			return 0;
+
+		//never more than a sample per couple of pixels, at least a few for the shape
+		double pixels = std::hypot(a.x * f / a.z - b.x * f / b.z, a.y * f / a.z - b.y * f / b.z);
+		int screenMax = std::max(2, int(pixels / pixelsPerSample));
+		int screenMin = std::max(2, int(pixels / (8 * pixelsPerSample)));
+		wanted = std::clamp(chunk.curvatureSamples, screenMin, screenMax);
+	}
 
-	sf::Vector2f center = sf::Vector2f(window_.getSize()) / 2.f;
-	//draw bodies with mass
-	for (const auto& b : sorted) {
-		float cx = b.second.x * f / b.second.z;
-		float cy = b.second.y * f / b.second.z;
-		float screenRadius = b.first->radius * f / b.second.z;
-
-		sf::CircleShape circle(screenRadius, 30 + int(b.first->radius * 5));
-		circle.setOrigin({ screenRadius, screenRadius });
-		circle.setPosition({ cx, cy });
-
-		sphereShader_.setUniform("lightDir", sf::Vector3f(ld));
-		sphereShader_.setUniform("radius", screenRadius);
-		sphereShader_.setUniform("pos", sf::Vector2f(cx, -cy) + center);
-		
-		//differenciate massless bodies
-		if (b.first->mass > 0)
-			sphereShader_.setUniform("baseColor", sf::Glsl::Vec3(1.f, 0.f, 0.f));
-		else
-			sphereShader_.setUniform("baseColor", sf::Glsl::Vec3(0.f, 1.f, 0.f));
-		window_.draw(circle, &sphereShader_);
+	//powers of two so that small camera movements dont trigger a resample
+	int samples = 2;
+	while (samples < wanted && samples < maxChunkSamples)
+		samples *= 2;
+	return samples;
+}
+
+void Engine3D::updateChunkCurvature(FieldChunk& chunk, const GravitySimulator& sim)
+{
+	//maximum chord error of the linear interpolation between samples
+	constexpr double tolerance = 0.05;
+
+	//second derivative of the drawn height along the chunk
+	double curvature = 0;
+	for (double t : { 0.0, 0.5, 1.0 }) {
+		Vec3 p = chunk.p0 * (1.0 - t) + chunk.p1 * t;
+		Hessian h = sim.getHessianAtPoint(p.x, p.z);
+		curvature = std::max(curvature, std::abs(chunk.alongZ ? h.zz : h.xx));
 	}
+	curvature *= GravitySimulator::getPotentialScaling();
+
+	//the chord error of a segment h long is curvature * h^2 / 8
+	double length = (chunk.p1 - chunk.p0).length();
+	//unbounded next to a body and inf at its center, nan falls to the cap as well
+	double wanted = std::ceil(length * std::sqrt(curvature / (8 * tolerance)));
+	chunk.curvatureSamples = int(std::max(0.0, std::min(double(maxChunkSamples), wanted)));
+	chunk.version = sim.getFieldVersion();
+	chunk.points.clear();
+}
+
+void Engine3D::sampleFieldChunk(FieldChunk& chunk, const GravitySimulator& sim, int samples)
+{
+	std::vector<double> xs(samples + 1), zs(samples + 1), potential(samples + 1);
+	std::vector<double> gradX(samples + 1), gradZ(samples + 1);
+
+	for (int i = 0; i <= samples; i++) {
+		double t = double(i) / samples;
+		xs[i] = chunk.p0.x * (1.0 - t) + chunk.p1.x * t;
+		zs[i] = chunk.p0.z * (1.0 - t) + chunk.p1.z * t;
+	}
+	sim.evaluatePotential(xs, zs, potential);
+	if (!chunk.isAxis)
+		sim.evaluateGradient(xs, zs, gradX, gradZ);
+
+	chunk.samples = samples;
+	chunk.points.resize(samples + 1);
+	chunk.colors.resize(samples + 1);
+	chunk.minY = std::numeric_limits<double>::max();
+	chunk.maxY = std::numeric_limits<double>::lowest();
+	for (int i = 0; i <= samples; i++) {
+		chunk.points[i] = Vec3(xs[i], -potential[i], zs[i]);
+		chunk.minY = std::min(chunk.minY, chunk.points[i].y);
+		chunk.maxY = std::max(chunk.maxY, chunk.points[i].y);
+
+		if (chunk.isAxis) {
+			if (chunk.alongZ)
+				chunk.colors[i] = sf::Color(0, 255, 255);
+			else
+				chunk.colors[i] = sf::Color(255, 0, 255);
+		}
+		else {
+			double grad = chunk.alongZ ? gradZ[i] : gradX[i];
+			float g = std::clamp(grad / 4, -0.5, 0.5) + 0.5;
+			chunk.colors[i] = sf::Color(255 * (1 - g), 255 * g, 0);
+		}
+	}
+}
+
+void Engine3D::renderBodies(const std::vector<Body>& bodies)
+{
+	PROFILE_SCOPE("Engine3D::renderBodies");
+	auto sorted = projectBodies(bodies, f);
+
+	//one quad per body, the texture coordinates map it to [-1, 1] with y up
+	//and the color carries the base color of the sphere
+	bodyVertices_.resize(sorted.size() * 6);
+	const sf::Vector2f corners[6] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, -1 }, { 1, 1 }, { -1, 1 } };
+
+	#pragma omp parallel for schedule(static)
+	for (int k = 0; k < int(sorted.size()); k++) {
+		const auto& b = sorted[k];
+		for (int c = 0; c < 6; c++) {
+			auto& v = bodyVertices_[k * 6 + c];
+			v.position = b.center + corners[c] * b.radius;
+			v.texCoords = { corners[c].x, -corners[c].y };
+			v.color = b.color;
+		}
+	}
+
+	sphereShader_.setUniform("lightDir", sf::Vector3f(lightInCameraSpace()));
+	window_.draw(bodyVertices_, &sphereShader_);
 }
 
 void Engine3D::renderPoints(const std::vector<Vec3>& points)
 {
+	PROFILE_SCOPE("Engine3D::renderPoints");
+	constexpr int segments = 12;
+	pointVertices_.clear();
+
 	for (const auto& p : points) {
 		auto rel = transformToCameraSpace(p);
 		if (rel.z <= 0)
 			continue;
 
-		float cx = rel.x * f / rel.z;
-		float cy = rel.y * f / rel.z;
+		sf::Vector2f c(rel.x * f / rel.z, rel.y * f / rel.z);
 		float screenRadius = 1 * f / rel.z;
 
-		sf::CircleShape circle(screenRadius);
-		circle.setOrigin({ screenRadius, screenRadius });
-		circle.setPosition({ cx, cy });
-		circle.setFillColor(sf::Color(0, 0, 255));
+		//disc as a fan of triangles, all the points are drawn at once
+		sf::Vertex v;
+		v.color = sf::Color(0, 0, 255);
+		for (int i = 0; i < segments; i++) {
+			float a0 = 2 * PI * i / segments, a1 = 2 * PI * (i + 1) / segments;
+			v.position = c;
+			pointVertices_.append(v);
+			v.position = c + sf::Vector2f(std::cos(a0), std::sin(a0)) * screenRadius;
+			pointVertices_.append(v);
+			v.position = c + sf::Vector2f(std::cos(a1), std::sin(a1)) * screenRadius;
+			pointVertices_.append(v);
+		}
+	}
+
+	window_.draw(pointVertices_);
+}
+
+void Engine3D::rasterizeBodies(const std::vector<Body>& bodies, sf::Image& image) const
+{
+	PROFILE_SCOPE("Engine3D::rasterizeBodies");
+	const sf::Vector2u size = image.getSize();
+	const double imageF = 1.0 / tan(camera_.fov * 0.5) * size.x / 2.0;
+	const auto sorted = projectBodies(bodies, imageF);
+	const Vec3 ld = lightInCameraSpace();
+	const sf::Vector2f center = sf::Vector2f(size) / 2.f;
+
+	//same shading as sphere.frag, farthest bodies first
+	#pragma omp parallel for schedule(dynamic)
+	for (int y = 0; y < int(size.y); y++) {
+		float py = y + 0.5f - center.y;
+
+		for (const auto& b : sorted) {
+			if (std::abs(py - b.center.y) > b.radius)
+				continue;
+
+			int x0 = std::max(0, int(b.center.x - b.radius + center.x));
+			int x1 = std::min(int(size.x) - 1, int(b.center.x + b.radius + center.x));
+			for (int x = x0; x <= x1; x++) {
+				double px = (x + 0.5 - center.x - b.center.x) / b.radius;
+				double pz = -(py - b.center.y) / b.radius;
+
+				double r2 = px * px + pz * pz;
+				if (r2 > 1.0)
+					continue;
+
+				Vec3 normal = Vec3(px, pz, std::sqrt(1.0 - r2)).normalized();
+				double diff = std::max(normal.dot(ld), 0.05);
+				auto channel = [diff](std::uint8_t c) {
+					return std::uint8_t(255 * std::pow(c / 255.0 * diff, 1.0 / 2.2));
+					};
+				image.setPixel({ unsigned(x), unsigned(y) }, 
+					sf::Color(channel(b.color.r), channel(b.color.g), channel(b.color.b)));
+			}
+		}
+	}
+}
+
+std::vector<Engine3D::ProjectedBody> Engine3D::projectBodies(const std::vector<Body>& bodies, double focal) const
+{
+	std::vector<ProjectedBody> projected(bodies.size());
+	std::vector<char> visible(bodies.size());
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < int(bodies.size()); i++) {
+		const auto& b = bodies[i];
+		auto relPos = transformToCameraSpace(b.position);
+		visible[i] = relPos.z > 0;
+		if (!visible[i])
+			continue;
 
-		window_.draw(circle);
+		auto& p = projected[i];
+		p.center = sf::Vector2f(relPos.x * focal / relPos.z, relPos.y * focal / relPos.z);
+		p.radius = b.radius * focal / relPos.z;
+		p.depth = relPos.z;
+		//differenciate massless bodies
+		p.color = b.mass > 0 ? sf::Color(255, 0, 0) : sf::Color(0, 255, 0);
 	}
+
+	std::vector<ProjectedBody> sorted;
+	sorted.reserve(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++)
+		if (visible[i])
+			sorted.push_back(projected[i]);
+
+	std::sort(sorted.begin(), sorted.end(), [](const ProjectedBody& a, const ProjectedBody& b) {
+		return a.depth > b.depth;
+		});
+
+	return sorted;
+}
+
+Vec3 Engine3D::lightInCameraSpace() const
+{
+	//rotate light direction vector into inverted camera space
+	double cosYaw = cos(camera_.yaw), sinYaw = sin(camera_.yaw);
+	double cosPitch = cos(camera_.pitch), sinPitch = sin(camera_.pitch);
+	auto ld = Vec3{
+		lightDirection_.x * cosYaw + lightDirection_.z * sinYaw,
+		lightDirection_.y,
+		lightDirection_.z * cosYaw - lightDirection_.x * sinYaw
+	};
+	return Vec3{
+		ld.x,
+		-(ld.y * cosPitch + ld.z * sinPitch),
+		ld.z * cosPitch - ld.y * sinPitch
+	}.normalized();
 }
 
 Vec3 Engine3D::transformToCameraSpace(const Vec3& pos) const
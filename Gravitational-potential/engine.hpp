@@ -2,6 +2,7 @@
 #include <SFML/Graphics.hpp>
 #include <functional>
 #include "gravity.hpp"
+#include "volume.hpp"
 
 class Engine3D {
 public:
@@ -10,8 +11,12 @@ public:
     
 	int handleEvents();
 	void renderPotentialField(GravitySimulator& sim);
+	//equipotential surfaces of the full 3D field, an alternative to the height map of the y = 0 plane
+	void renderFieldVolume(const GravitySimulator& sim);
 	void renderBodies(const std::vector<Body>& bodies);
 	void renderPoints(const std::vector<Vec3>& points);
+	//cpu fallback of renderBodies, draws over the image as seen from the camera
+	void rasterizeBodies(const std::vector<Body>& bodies, sf::Image& image) const;
 
 private:
 	// by default the camera is looking in the positive z direction
@@ -27,8 +32,48 @@ private:
 		double pitch = 0.0;
 	    //in radiants
 	    double fov = 0.0;
+
+		bool operator==(const Camera&) const = default;
+	};
+
+	//piece of a grid line of the potential field, culled and sampled on its own
+	struct FieldChunk {
+		Vec3 p0, p1;
+		//index of the grid line, far lines are thinned out by index
+		int line = 0;
+		//direction and color of the whole line
+		bool alongZ = false;
+		bool isAxis = false;
+
+		//field version the samples and curvature belong to
+		unsigned long long version = 0;
+		//samples needed by the curvature of the potential along the chunk
+		int curvatureSamples = 0;
+		int samples = 0;
+		double minY = 0, maxY = 0;
+		std::vector<Vec3> points;
+		std::vector<sf::Color> colors;
 	};
 
+	void buildFieldChunks();
+	//false if the chunk bounding box is outside the view frustum
+	bool isChunkVisible(const FieldChunk& chunk, double minY, double maxY) const;
+	//samples for the chunk from its size on screen and the curvature of the field
+	int chunkSamples(const FieldChunk& chunk) const;
+	void sampleFieldChunk(FieldChunk& chunk, const GravitySimulator& sim, int samples);
+	void updateChunkCurvature(FieldChunk& chunk, const GravitySimulator& sim);
+
+	//body projected on screen
+	struct ProjectedBody {
+		sf::Vector2f center;
+		float radius = 0;
+		double depth = 0;
+		sf::Color color;
+	};
+
+	//visible bodies sorted back to front
+	std::vector<ProjectedBody> projectBodies(const std::vector<Body>& bodies, double focal) const;
+	Vec3 lightInCameraSpace() const;
 	Vec3 transformToCameraSpace(const Vec3& pos) const;
 
 	sf::RenderWindow window_;
@@ -36,6 +81,8 @@ private:
 
 	Vec3 lightDirection_;
 	sf::Shader sphereShader_;
+	sf::VertexArray bodyVertices_{ sf::PrimitiveType::Triangles };
+	sf::VertexArray pointVertices_{ sf::PrimitiveType::Triangles };
 
 	sf::Vector2i lastMousePos_;
 	bool isFullscreen_ = false;
@@ -44,6 +91,28 @@ private:
 	sf::ContextSettings settings_;
 
 	double f = 0;
+
+	std::vector<FieldChunk> fieldChunks_;
+	//visible chunks as a single list of segments
+	sf::VertexArray fieldVertices_{ sf::PrimitiveType::Lines };
+	unsigned long long projectedFieldVersion_ = 0;
+	//camera and window the field vertices were last projected with
+	Camera projectedCamera_;
+	double projectedF_ = 0;
+	sf::Vector2u projectedSize_;
+
+	FieldVolume fieldVolume_;
+	sf::VertexArray volumeVertices_{ sf::PrimitiveType::Triangles };
+	unsigned long long projectedVolumeVersion_ = 0;
+	Camera volumeCamera_;
+	double volumeF_ = 0;
+	sf::Vector2u volumeSize_;
+
+	static constexpr int chunksPerLine = 16;
+	static constexpr int maxChunkSamples = 128;
+	//screen spacing under which far lines get thinned out
+	static constexpr double minLineSpacing = 6.0;
+
 	//field centered at (0, 0)
 	const int fieldSideSize_;
 	const int fieldLineNum_;
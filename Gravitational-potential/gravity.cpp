@@ -1,7 +1,14 @@
 #include "gravity.hpp"
+#include "profiler.hpp"
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <unordered_map>
+#include <array>
+#include <limits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 GravitySimulator::GravitySimulator(unsigned int fieldSideSize, unsigned int candidatesPerSide)
 	:
@@ -13,23 +20,19 @@ GravitySimulator::GravitySimulator(unsigned int fieldSideSize, unsigned int cand
 double GravitySimulator::getPotentialAtPoint(double x, double z) const
 {
 	double potential = 0.0;
-	for (const auto& b : bodies_) {
-		//skip massless bodies
-		if (b->mass <= 0.0)
-			continue;
-
-		double dx = x - b->position.x;
-		double dz = z - b->position.z;
+	for (size_t b = 0; b < massive_.mass.size(); b++) {
+		double dx = x - massive_.x[b];
+		double dz = z - massive_.z[b];
 		double r = std::sqrt(dx * dx + dz * dz);
 
 		//outside the mass
-		if (r >= b->radius)
-			potential += -G * b->mass / r;
+		if (r >= massive_.radius[b])
+			potential += -G * massive_.mass[b] / r;
 		//inside the mass (uniform sphere)
 		else {
-			double R = b->radius;
+			double R = massive_.radius[b];
 			double rr = r / R;
-			potential += -G * b->mass * (3.0 - rr * rr) / (2.0 * R);
+			potential += -G * massive_.mass[b] * (3.0 - rr * rr) / (2.0 * R);
 		}
 	}
 
@@ -39,22 +42,18 @@ double GravitySimulator::getPotentialAtPoint(double x, double z) const
 Gradient GravitySimulator::getGradientAtPoint(double x, double z) const
 {
     Gradient g;
-	for (const auto& b : bodies_) {
-		//skip massless bodies
-		if (b->mass <= 0.0)
-			continue;
-
-		double dx = x - b->position.x;
-		double dz = z - b->position.z;
+	for (size_t b = 0; b < massive_.mass.size(); b++) {
+		double dx = x - massive_.x[b];
+		double dz = z - massive_.z[b];
 		double r = std::sqrt(dx * dx + dz * dz);
 
 		//not a shortcut, actual formula
-		if (r < b->radius)
-			r = b->radius;
+		if (r < massive_.radius[b])
+			r = massive_.radius[b];
 
 		double invr3 = 1.0 / (r * r * r);
-		g.x += G * b->mass * dx * invr3;
-		g.z += G * b->mass * dz * invr3;
+		g.x += G * massive_.mass[b] * dx * invr3;
+		g.z += G * massive_.mass[b] * dz * invr3;
 	}
 
 	return g;
@@ -63,160 +62,841 @@ Gradient GravitySimulator::getGradientAtPoint(double x, double z) const
 Hessian GravitySimulator::getHessianAtPoint(double x, double z) const
 {
     Hessian h;
-	for (const auto& b : bodies_) {
-		//skip massless bodies
-		if (b->mass <= 0.0)
-			continue;
+	for (size_t b = 0; b < massive_.mass.size(); b++) {
+		const double m = massive_.mass[b];
+		const double R = massive_.radius[b];
 
-		double dx = x - b->position.x;
-		double dz = z - b->position.z;
+		double dx = x - massive_.x[b];
+		double dz = z - massive_.z[b];
 		double r2 = dx * dx + dz * dz;
 		double r = std::sqrt(r2);
 
 		//not a shortcut, actual formula
-		if (r < b->radius) {
-			double invr3 = 1.0 / (b->radius * b->radius * b->radius);
-			h.xx += G * b->mass * invr3;
+		if (r < R) {
+			double invr3 = 1.0 / (R * R * R);
+			h.xx += G * m * invr3;
 			h.xz += 0;
 			h.zx += 0;
-			h.zz += G * b->mass * invr3;
+			h.zz += G * m * invr3;
 		}
 		else {
 			double invr5 = 1.0 / (r2 * r2 * r);
-			h.xx += G * b->mass * (r2 - 3 * dx * dx) * invr5;
-			h.xz += -G * b->mass * 3 * dx * dz * invr5;
-			h.zx += -G * b->mass * 3 * dx * dz * invr5;
-			h.zz += G * b->mass * (r2 - 3 * dz * dz) * invr5;
+			h.xx += G * m * (r2 - 3 * dx * dx) * invr5;
+			h.xz += -G * m * 3 * dx * dz * invr5;
+			h.zx += -G * m * 3 * dx * dz * invr5;
+			h.zz += G * m * (r2 - 3 * dz * dz) * invr5;
 		}
 	}
 
     return h;
 }
 
+double GravitySimulator::getPotentialFloor() const
+{
+	//the deepest point of each well is the center of the uniform sphere
+	double potential = 0.0;
+	for (size_t b = 0; b < massive_.mass.size(); b++)
+		potential += -G * massive_.mass[b] * 3.0 / (2.0 * massive_.radius[b]);
+
+	return potential * potentialScaling;
+}
+
+void GravitySimulator::evaluatePotential(std::span<const double> xs, std::span<const double> zs, std::span<double> out) const
+{
+	const size_t n = std::min({ xs.size(), zs.size(), out.size() });
+	const size_t bodyNum = massive_.mass.size();
+	size_t i = 0;
+
+#ifdef __AVX2__
+	//4 targets per lane set, bodies are broadcast one at a time
+	const __m256d three = _mm256_set1_pd(3.0);
+	const __m256d half = _mm256_set1_pd(0.5);
+	for (; i + 4 <= n; i += 4) {
+		const __m256d x = _mm256_loadu_pd(xs.data() + i);
+		const __m256d z = _mm256_loadu_pd(zs.data() + i);
+		__m256d potential = _mm256_setzero_pd();
+
+		for (size_t b = 0; b < bodyNum; b++) {
+			const __m256d gm = _mm256_set1_pd(-G * massive_.mass[b]);
+			const __m256d R = _mm256_set1_pd(massive_.radius[b]);
+			const __m256d invR = _mm256_set1_pd(1.0 / massive_.radius[b]);
+
+			__m256d dx = _mm256_sub_pd(x, _mm256_set1_pd(massive_.x[b]));
+			__m256d dz = _mm256_sub_pd(z, _mm256_set1_pd(massive_.z[b]));
+			__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dz, dz));
+			__m256d r = _mm256_sqrt_pd(r2);
+
+			//outside the mass: -G m / r
+			__m256d outside = _mm256_div_pd(gm, r);
+			//inside the mass: -G m (3 - (r/R)^2) / 2R
+			__m256d rr2 = _mm256_mul_pd(r2, _mm256_mul_pd(invR, invR));
+			__m256d inside = _mm256_mul_pd(_mm256_mul_pd(gm, _mm256_sub_pd(three, rr2)), _mm256_mul_pd(half, invR));
+
+			__m256d isOutside = _mm256_cmp_pd(r, R, _CMP_GE_OQ);
+			potential = _mm256_add_pd(potential, _mm256_blendv_pd(inside, outside, isOutside));
+		}
+
+		_mm256_storeu_pd(out.data() + i, _mm256_mul_pd(potential, _mm256_set1_pd(potentialScaling)));
+	}
+#endif
+
+	for (; i < n; i++)
+		out[i] = getPotentialAtPoint(xs[i], zs[i]);
+}
+
+double GravitySimulator::getPotentialAt(const Vec3& p) const
+{
+	double potential = 0.0;
+	for (size_t b = 0; b < massive_.mass.size(); b++) {
+		double dx = p.x - massive_.x[b];
+		double dy = p.y - massive_.y[b];
+		double dz = p.z - massive_.z[b];
+		double r = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+		if (r >= massive_.radius[b])
+			potential += -G * massive_.mass[b] / r;
+		else {
+			double R = massive_.radius[b];
+			double rr = r / R;
+			potential += -G * massive_.mass[b] * (3.0 - rr * rr) / (2.0 * R);
+		}
+	}
+
+	return potential * potentialScaling;
+}
+
+Vec3 GravitySimulator::getGradientAt(const Vec3& p) const
+{
+	Vec3 g;
+	for (size_t b = 0; b < massive_.mass.size(); b++) {
+		Vec3 d(p.x - massive_.x[b], p.y - massive_.y[b], p.z - massive_.z[b]);
+		double r = std::max(d.length(), massive_.radius[b]);
+		g += d * (G * massive_.mass[b] / (r * r * r));
+	}
+
+	return g;
+}
+
+void GravitySimulator::evaluatePotential(std::span<const double> xs, std::span<const double> ys, 
+	std::span<const double> zs, std::span<double> out) const
+{
+	const size_t n = std::min({ xs.size(), ys.size(), zs.size(), out.size() });
+	const size_t bodyNum = massive_.mass.size();
+	size_t i = 0;
+
+#ifdef __AVX2__
+	//same as the planar version with the y term added
+	const __m256d three = _mm256_set1_pd(3.0);
+	const __m256d half = _mm256_set1_pd(0.5);
+	for (; i + 4 <= n; i += 4) {
+		const __m256d x = _mm256_loadu_pd(xs.data() + i);
+		const __m256d y = _mm256_loadu_pd(ys.data() + i);
+		const __m256d z = _mm256_loadu_pd(zs.data() + i);
+		__m256d potential = _mm256_setzero_pd();
+
+		for (size_t b = 0; b < bodyNum; b++) {
+			const __m256d gm = _mm256_set1_pd(-G * massive_.mass[b]);
+			const __m256d R = _mm256_set1_pd(massive_.radius[b]);
+			const __m256d invR = _mm256_set1_pd(1.0 / massive_.radius[b]);
+
+			__m256d dx = _mm256_sub_pd(x, _mm256_set1_pd(massive_.x[b]));
+			__m256d dy = _mm256_sub_pd(y, _mm256_set1_pd(massive_.y[b]));
+			__m256d dz = _mm256_sub_pd(z, _mm256_set1_pd(massive_.z[b]));
+			__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dz, dz)));
+			__m256d r = _mm256_sqrt_pd(r2);
+
+			__m256d outside = _mm256_div_pd(gm, r);
+			__m256d rr2 = _mm256_mul_pd(r2, _mm256_mul_pd(invR, invR));
+			__m256d inside = _mm256_mul_pd(_mm256_mul_pd(gm, _mm256_sub_pd(three, rr2)), _mm256_mul_pd(half, invR));
+
+			__m256d isOutside = _mm256_cmp_pd(r, R, _CMP_GE_OQ);
+			potential = _mm256_add_pd(potential, _mm256_blendv_pd(inside, outside, isOutside));
+		}
+
+		_mm256_storeu_pd(out.data() + i, _mm256_mul_pd(potential, _mm256_set1_pd(potentialScaling)));
+	}
+#endif
+
+	for (; i < n; i++)
+		out[i] = getPotentialAt(Vec3(xs[i], ys[i], zs[i]));
+}
+
+void GravitySimulator::evaluateGradient(std::span<const double> xs, std::span<const double> zs, 
+	std::span<double> outX, std::span<double> outZ) const
+{
+	const size_t n = std::min({ xs.size(), zs.size(), outX.size(), outZ.size() });
+	const size_t bodyNum = massive_.mass.size();
+	size_t i = 0;
+
+#ifdef __AVX2__
+	for (; i + 4 <= n; i += 4) {
+		const __m256d x = _mm256_loadu_pd(xs.data() + i);
+		const __m256d z = _mm256_loadu_pd(zs.data() + i);
+		__m256d gx = _mm256_setzero_pd();
+		__m256d gz = _mm256_setzero_pd();
+
+		for (size_t b = 0; b < bodyNum; b++) {
+			const __m256d gm = _mm256_set1_pd(G * massive_.mass[b]);
+			const __m256d R = _mm256_set1_pd(massive_.radius[b]);
+
+			__m256d dx = _mm256_sub_pd(x, _mm256_set1_pd(massive_.x[b]));
+			__m256d dz = _mm256_sub_pd(z, _mm256_set1_pd(massive_.z[b]));
+			__m256d r = _mm256_sqrt_pd(_mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dz, dz)));
+
+			//not a shortcut, actual formula
+			r = _mm256_max_pd(r, R);
+			__m256d k = _mm256_div_pd(gm, _mm256_mul_pd(r, _mm256_mul_pd(r, r)));
+			gx = _mm256_fmadd_pd(k, dx, gx);
+			gz = _mm256_fmadd_pd(k, dz, gz);
+		}
+
+		_mm256_storeu_pd(outX.data() + i, gx);
+		_mm256_storeu_pd(outZ.data() + i, gz);
+	}
+#endif
+
+	for (; i < n; i++) {
+		auto g = getGradientAtPoint(xs[i], zs[i]);
+		outX[i] = g.x;
+		outZ[i] = g.z;
+	}
+}
+
 void GravitySimulator::step(double dt)
+{
+	PROFILE_SCOPE("GravitySimulator::step");
+	switch (integrator_) {
+	case Integrator::Leapfrog:
+		leapfrogStep(dt);
+		break;
+	case Integrator::Yoshida4: {
+		//triple jump, the middle step goes backwards in time
+		const double w1 = 1.0 / (2.0 - std::cbrt(2.0));
+		const double w0 = 1.0 - 2.0 * w1;
+		for (double w : { w1, w0, w1 })
+			leapfrogStep(w * dt);
+		break;
+	}
+	case Integrator::Yoshida6: {
+		//yoshida 1990, solution A
+		const double w1 = -1.17767998417887, w2 = 0.235573213359357, w3 = 0.784513610477560;
+		const double w0 = 1.0 - 2.0 * (w1 + w2 + w3);
+		for (double w : { w3, w2, w1, w0, w1, w2, w3 })
+			leapfrogStep(w * dt);
+		break;
+	}
+	case Integrator::Hermite:
+		hermiteStep(dt);
+		break;
+	}
+
+	//merged bodies change the state the integrators carried over
+	if (resolveCollisions()) {
+		accelsValid_ = false;
+		hermiteValid_ = false;
+	}
+	syncBodyStorage();
+}
+
+void GravitySimulator::leapfrogStep(double dt)
 {
 	const size_t n = bodies_.size();
-	std::vector<Vec3> accels;
 
-	computeAccelerations(accels);
+	//the accelerations at the end of a step are the ones at the start of the next
+	if (!accelsValid_)
+		computeAccelerations(accels_);
+
 	for (size_t i = 0; i < n; ++i)
-		bodies_[i]->velocity += accels[i] * (0.5 * dt);
+		bodies_[i].velocity += accels_[i] * (0.5 * dt);
 
-	for (auto* b : bodies_)
-		b->position += b->velocity * dt;
+	for (auto& b : bodies_)
+		b.position += b.velocity * dt;
 
-	computeAccelerations(accels);
+	computeAccelerations(accels_);
 	for (size_t i = 0; i < n; ++i)
-		bodies_[i]->velocity += accels[i] * (0.5 * dt);
+		bodies_[i].velocity += accels_[i] * (0.5 * dt);
+
+	accelsValid_ = true;
+}
+
+void GravitySimulator::hermiteStep(double dt)
+{
+	PROFILE_SCOPE("GravitySimulator::hermiteStep");
+	const size_t n = bodies_.size();
+	const long long frameTicks = 1ll << maxBlockLevel;
+	const double tickDt = dt / frameTicks;
+
+	std::vector<Vec3> pos(n), vel(n);
+	for (size_t i = 0; i < n; i++) {
+		pos[i] = bodies_[i].position;
+		vel[i] = bodies_[i].velocity;
+	}
+
+	//largest power of two number of ticks not above the given timestep
+	auto quantize = [&](double h, long long tick, long long maxTicks) {
+		long long ticks = maxTicks;
+		while (ticks > 1 && (ticks * tickDt > h || tick % ticks != 0))
+			ticks /= 2;
+		return ticks;
+		};
+
+	//the block timesteps are relative to dt, so they are restarted if it changes
+	if (!hermiteValid_ || hermite_.size() != n || hermiteDt_ != dt) {
+		hermite_.assign(n, {});
+		for (size_t i = 0; i < n; i++) {
+			computeAccelerationAndJerk(i, pos, vel, hermite_[i].acc, hermite_[i].jerk);
+
+			double a = hermite_[i].acc.length(), j = hermite_[i].jerk.length();
+			double h = j > 0 ? 0.01 * a / j : dt;
+			hermite_[i].stepTicks = quantize(h, 0, frameTicks);
+		}
+		hermiteValid_ = true;
+		hermiteDt_ = dt;
+	}
+
+	for (auto& hb : hermite_)
+		hb.tick = 0;
+
+	std::vector<Vec3> predPos(n), predVel(n);
+	std::vector<size_t> active;
+	while (true) {
+		//the next block is made of all the bodies due at the earliest time
+		long long next = frameTicks + 1;
+		for (const auto& hb : hermite_)
+			next = std::min(next, hb.tick + hb.stepTicks);
+		if (next > frameTicks)
+			break;
+
+		active.clear();
+		for (size_t i = 0; i < n; i++)
+			if (hermite_[i].tick + hermite_[i].stepTicks == next)
+				active.push_back(i);
+
+		//predict every body to the block time
+		for (size_t i = 0; i < n; i++) {
+			const auto& hb = hermite_[i];
+			double h = (next - hb.tick) * tickDt;
+			predPos[i] = pos[i] + vel[i] * h + hb.acc * (h * h / 2) + hb.jerk * (h * h * h / 6);
+			predVel[i] = vel[i] + hb.acc * h + hb.jerk * (h * h / 2);
+		}
+
+		//correct the active bodies with the forces at the predicted state
+		std::vector<Vec3> newAcc(active.size()), newJerk(active.size());
+		for (size_t k = 0; k < active.size(); k++)
+			computeAccelerationAndJerk(active[k], predPos, predVel, newAcc[k], newJerk[k]);
+
+		for (size_t k = 0; k < active.size(); k++) {
+			size_t i = active[k];
+			auto& hb = hermite_[i];
+			const double h = hb.stepTicks * tickDt;
+			const Vec3 a0 = hb.acc, j0 = hb.jerk, a1 = newAcc[k], j1 = newJerk[k];
+
+			//snap and crackle from the hermite interpolation
+			Vec3 snap = ((a1 - a0) * 6.0 - (j0 * 4.0 + j1 * 2.0) * h) / (h * h);
+			Vec3 crackle = ((a0 - a1) * 12.0 + (j0 + j1) * (6.0 * h)) / (h * h * h);
+
+			double h2 = h * h, h3 = h2 * h, h4 = h3 * h, h5 = h4 * h;
+			pos[i] = predPos[i] + snap * (h4 / 24) + crackle * (h5 / 120);
+			vel[i] = predVel[i] + snap * (h3 / 6) + crackle * (h4 / 24);
+			hb.acc = a1;
+			hb.jerk = j1;
+			hb.tick = next;
+
+			//aarseth criterion with the snap at the end of the step
+			Vec3 snap1 = snap + crackle * h;
+			double a = a1.length(), j = j1.length(), s = snap1.length(), c = crackle.length();
+			double den = j * c + s * s;
+			double newH = den > 0 ? std::sqrt(hermiteEta * (a * s + j * j) / den) : dt;
+
+			//at most double the timestep and stay aligned to the block grid
+			hb.stepTicks = quantize(newH, next, std::min(2 * hb.stepTicks, frameTicks));
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		bodies_[i].position = pos[i];
+		bodies_[i].velocity = vel[i];
+	}
 }
 
-void GravitySimulator::calculateStabilityPoints(std::vector<Vec3>& points) const
+void GravitySimulator::calculateStabilityPoints(std::vector<Vec3>& points)
 {
+	PROFILE_SCOPE("GravitySimulator::calculateStabilityPoints");
+    const double d = fieldSideSize_ / double(candidatesPerSide_);
+
+	//(cell index, point) so that the result doesnt depend on the thread count
+	std::vector<std::pair<int, Vec3>> candidates;
+
+	//bodies barely moved since the grid was sampled: the stability points
+	//moved just as little, so newton is restarted from the previous ones
+	if (!lastStabilityPoints_.empty() && bodiesMovedSinceSampling() < d * reuseDistance) {
+		const int n = int(lastStabilityPoints_.size());
+		candidates.resize(n, { -1, Vec3() });
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int k = 0; k < n; k++) {
+			double x = lastStabilityPoints_[k].x;
+			double z = lastStabilityPoints_[k].z;
+			if (refineStabilityPoint(x, z))
+				candidates[k] = { k, Vec3(x, 0.0, z) };
+		}
+
+		std::erase_if(candidates, [](const auto& c) { return c.first < 0; });
+	}
+	else {
+		sampleStabilityGrid();
+		findStabilityCandidates(candidates);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+		return a.first < b.first;
+		});
+
+	//deduplication through a spatial hash with cells as big as the threshold,
+	//so duplicates can only be in the neighbouring cells
+	constexpr double mergeThreshold = 0.0001;
+	auto cellKey = [](long long cx, long long cz) {
+		return (cx << 32) ^ (cz & 0xffffffff);
+		};
+	std::unordered_map<long long, std::vector<size_t>> cells;
+
     points.clear();
+	for (const auto& [cell, c] : candidates) {
+		long long cx = (long long)std::floor(c.x / mergeThreshold);
+		long long cz = (long long)std::floor(c.z / mergeThreshold);
+
+		bool unique = true;
+		for (long long ox = -1; ox <= 1 && unique; ox++) {
+			for (long long oz = -1; oz <= 1 && unique; oz++) {
+				auto it = cells.find(cellKey(cx + ox, cz + oz));
+				if (it == cells.end())
+					continue;
+
+				for (size_t idx : it->second) {
+					if (std::hypot(c.x - points[idx].x, c.z - points[idx].z) < mergeThreshold) {
+						unique = false;
+						break;
+					}
+				}
+			}
+		}
+
+		if (unique) {
+			cells[cellKey(cx, cz)].push_back(points.size());
+			points.push_back(c);
+		}
+	}
+
+	for (auto& p : points)
+		p.y = -getPotentialAtPoint(p.x, p.z);
+
+	lastStabilityPoints_ = points;
+}
 
+void GravitySimulator::sampleStabilityGrid()
+{
+	PROFILE_SCOPE("GravitySimulator::sampleStabilityGrid");
     const double d = fieldSideSize_ / double(candidatesPerSide_);
-    constexpr int maxNewtonIter = 50;
-    constexpr double gradThreshold = 0.001;
-    constexpr double stepDamping = 0.5;
+	const int sideSamples = candidatesPerSide_ + 1;
+	stabilitySamples_.resize(sideSamples * sideSamples);
+
+	#pragma omp parallel
+	{
+		std::vector<double> xs(sideSamples), zs(sideSamples), gx(sideSamples), gz(sideSamples);
+		for (int j = 0; j < sideSamples; j++)
+			zs[j] = -fieldSideSize_ / 2.f + j * d;
+
+		#pragma omp for schedule(static)
+		for (int i = 0; i < sideSamples; i++) {
+			std::fill(xs.begin(), xs.end(), -fieldSideSize_ / 2.f + i * d);
+			evaluateGradient(xs, zs, gx, gz);
+			for (int j = 0; j < sideSamples; j++)
+				stabilitySamples_[i * sideSamples + j] = { gx[j], gz[j] };
+		}
+	}
+
+	sampledX_ = massive_.x;
+	sampledZ_ = massive_.z;
+}
+
+void GravitySimulator::findStabilityCandidates(std::vector<std::pair<int, Vec3>>& candidates) const
+{
+    const double d = fieldSideSize_ / double(candidatesPerSide_);
+	const int sideSamples = candidatesPerSide_ + 1;
+	//accessed with [x * (candidatesPerSide_ + 1) + z]
+	const auto& samples = stabilitySamples_;
 
 	//check if the sign doesnt agree
     auto sc = [](double a, double b) {
         return (a <= 0.0 && b >= 0.0) || (a >= 0.0 && b <= 0.0);
         };
 
-	//accessed with [x * (candidatesPerSide_ + 1) + z]
-	std::vector<Gradient> samples;
-	samples.reserve((candidatesPerSide_ + 1) * (candidatesPerSide_ + 1));
-	for (int i = 0; i < candidatesPerSide_ + 1; i++) {
-		for (int j = 0; j < candidatesPerSide_ + 1; j++) {
-			double x0 = -fieldSideSize_ / 2.f + i * d;
-			double z0 = -fieldSideSize_ / 2.f + j * d;
-			samples.push_back(getGradientAtPoint(x0, z0));
+	#pragma omp parallel
+	{
+		//each thread collects its own candidates, merged at the end
+		std::vector<std::pair<int, Vec3>> local;
+
+		#pragma omp for schedule(dynamic) nowait
+		for (int i = 0; i < candidatesPerSide_; i++) {
+			for (int j = 0; j < candidatesPerSide_; j++) {
+				auto g00 = samples[i * sideSamples + j];
+				auto g10 = samples[(i + 1) * sideSamples + j];
+				auto g01 = samples[i * sideSamples + j + 1];
+				auto g11 = samples[(i + 1) * sideSamples + j + 1];
+
+				bool xZero = sc(g00.x, g10.x) || sc(g00.x, g01.x) || sc(g00.x, g11.x);
+				bool zZero = sc(g00.z, g10.z) || sc(g00.z, g01.z) || sc(g00.z, g11.z);
+
+				if (!xZero || !zZero)
+					continue;
+
+				double x = -fieldSideSize_ / 2.f + (i + 0.5) * d;
+				double z = -fieldSideSize_ / 2.f + (j + 0.5) * d;
+
+				if (refineStabilityPoint(x, z))
+					local.push_back({ i * candidatesPerSide_ + j, Vec3(x, 0.0, z) });
+			}
 		}
+
+		#pragma omp critical
+		candidates.insert(candidates.end(), local.begin(), local.end());
+	}
+}
+
+bool GravitySimulator::refineStabilityPoint(double& x, double& z) const
+{
+    constexpr int maxNewtonIter = 50;
+    constexpr double gradThreshold = 0.001;
+    constexpr double stepDamping = 0.5;
+
+	for (int iter = 0; iter < maxNewtonIter; ++iter) {
+		auto g = getGradientAtPoint(x, z);
+		double gnorm = std::hypot(g.x, g.z);
+
+		if (gnorm < gradThreshold)
+			break;
+
+		Hessian H = getHessianAtPoint(x, z);
+		double det = H.xx * H.zz - H.xz * H.zx;
+
+		if (std::abs(det) < 1e-12)
+			break;
+
+		//newton step
+		double dx = (-H.zz * g.x + H.xz * g.z) / det;
+		double dz = (H.zx * g.x - H.xx * g.z) / det;
+
+		x += stepDamping * dx;
+		z += stepDamping * dz;
 	}
 
-    std::vector<Vec3> candidates;
-    for (int i = 0; i < candidatesPerSide_; i++) {
-        for (int j = 0; j < candidatesPerSide_; j++) {
-            auto g00 = samples[i * (candidatesPerSide_ + 1) + j];
-			auto g10 = samples[(i + 1) * (candidatesPerSide_ + 1) + j];
-			auto g01 = samples[i * (candidatesPerSide_ + 1) + j + 1];
-			auto g11 = samples[(i + 1) * (candidatesPerSide_ + 1) + j + 1];
+	auto gFinal = getGradientAtPoint(x, z);
+	return std::hypot(gFinal.x, gFinal.z) < gradThreshold;
+}
 
-            bool xZero = sc(g00.x, g10.x) || sc(g00.x, g01.x) || sc(g00.x, g11.x);
-            bool zZero = sc(g00.z, g10.z) || sc(g00.z, g01.z) || sc(g00.z, g11.z);
+double GravitySimulator::bodiesMovedSinceSampling() const
+{
+	//bodies were added since the last sampling
+	if (sampledX_.size() != massive_.x.size())
+		return std::numeric_limits<double>::infinity();
 
-            if (!xZero || !zZero)
-                continue;
+	double maxDist = 0.0;
+	for (size_t b = 0; b < sampledX_.size(); b++)
+		maxDist = std::max(maxDist, std::hypot(massive_.x[b] - sampledX_[b], massive_.z[b] - sampledZ_[b]));
 
-            double x = -fieldSideSize_ / 2.f + (i + 0.5) * d;
-            double z = -fieldSideSize_ / 2.f + (j + 0.5) * d;
+	return maxDist;
+}
 
-            for (int iter = 0; iter < maxNewtonIter; ++iter) {
-                auto g = getGradientAtPoint(x, z);
-                double gnorm = std::hypot(g.x, g.z);
+void GravitySimulator::syncBodyStorage()
+{
+	massive_.x.clear();
+	massive_.y.clear();
+	massive_.z.clear();
+	massive_.mass.clear();
+	massive_.radius.clear();
 
-                if (gnorm < gradThreshold)
-                    break;
+	//massless bodies dont contribute to the field
+	for (const auto& b : bodies_) {
+		if (b.mass <= 0.0)
+			continue;
 
-                Hessian H = getHessianAtPoint(x, z);
-                double det = H.xx * H.zz - H.xz * H.zx;
+		massive_.x.push_back(b.position.x);
+		massive_.y.push_back(b.position.y);
+		massive_.z.push_back(b.position.z);
+		massive_.mass.push_back(b.mass);
+		massive_.radius.push_back(b.radius);
+	}
+	fieldVersion_++;
+}
 
-                if (std::abs(det) < 1e-12)
-                    break;
+bool GravitySimulator::resolveCollisions()
+{
+	PROFILE_SCOPE("GravitySimulator::resolveCollisions");
+	const int n = int(bodies_.size());
+	if (n < 2)
+		return false;
+
+	double maxRadius = 0.0;
+	for (const auto& b : bodies_)
+		maxRadius = std::max(maxRadius, b.radius);
+
+	//uniform grid hashed into a table, overlapping bodies are at most one cell apart
+	const double cellSize = 2.0 * maxRadius;
+	size_t tableSize = 1;
+	while (tableSize < 2 * size_t(n))
+		tableSize *= 2;
+
+	auto cellOf = [cellSize](const Vec3& p) {
+		return std::array<long long, 3>{
+			(long long)std::floor(p.x / cellSize),
+			(long long)std::floor(p.y / cellSize),
+			(long long)std::floor(p.z / cellSize)
+		};
+		};
+	auto bucketOf = [tableSize](long long x, long long y, long long z) {
+		unsigned long long h = x * 73856093ull ^ y * 19349663ull ^ z * 83492791ull;
+		return size_t(h & (tableSize - 1));
+		};
+
+	//counting sort of the bodies by bucket
+	std::vector<size_t> bucket(n);
+	std::vector<int> bucketStart(tableSize + 1, 0);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; i++) {
+		auto c = cellOf(bodies_[i].position);
+		bucket[i] = bucketOf(c[0], c[1], c[2]);
+
+		#pragma omp atomic
+		bucketStart[bucket[i] + 1]++;
+	}
+	for (size_t k = 0; k < tableSize; k++)
+		bucketStart[k + 1] += bucketStart[k];
+
+	std::vector<int> sorted(n);
+	std::vector<int> fill(bucketStart.begin(), bucketStart.end() - 1);
+	for (int i = 0; i < n; i++)
+		sorted[fill[bucket[i]]++] = i;
+
+	//narrow phase over the 27 neighbouring cells
+	std::vector<std::pair<int, int>> pairs;
+	#pragma omp parallel
+	{
+		std::vector<std::pair<int, int>> local;
+		std::vector<size_t> buckets;
+
+		#pragma omp for schedule(dynamic, 64) nowait
+		for (int i = 0; i < n; i++) {
+			const Body& a = bodies_[i];
+			auto c = cellOf(a.position);
+
+			//different cells can share a bucket, each is visited once
+			buckets.clear();
+			for (int dx = -1; dx <= 1; dx++)
+				for (int dy = -1; dy <= 1; dy++)
+					for (int dz = -1; dz <= 1; dz++)
+						buckets.push_back(bucketOf(c[0] + dx, c[1] + dy, c[2] + dz));
+			std::sort(buckets.begin(), buckets.end());
+			buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+			for (size_t k : buckets) {
+				for (int s = bucketStart[k]; s < bucketStart[k + 1]; s++) {
+					int j = sorted[s];
+					const Body& b = bodies_[j];
+					//massless bodies go through each other
+					if (j <= i || (a.mass == 0.0 && b.mass == 0.0))
+						continue;
+
+					Vec3 r = b.position - a.position;
+					double minDist = a.radius + b.radius;
+					if (r.dot(r) < minDist * minDist)
+						local.push_back({ i, j });
+				}
+			}
+		}
 
-                //newton step
-                double dx = (-H.zz * g.x + H.xz * g.z) / det;
-                double dz = (H.zx * g.x - H.xx * g.z) / det;
+		#pragma omp critical
+		pairs.insert(pairs.end(), local.begin(), local.end());
+	}
 
-                x += stepDamping * dx;
-                z += stepDamping * dz;
-            }
+	if (pairs.empty())
+		return false;
+
+	//chains of collisions end up in a single body
+	std::vector<int> parent(n);
+	for (int i = 0; i < n; i++)
+		parent[i] = i;
+	auto find = [&](int i) {
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+		};
+	std::sort(pairs.begin(), pairs.end());
+	for (auto [i, j] : pairs) {
+		int ri = find(i), rj = find(j);
+		if (ri != rj)
+			parent[std::max(ri, rj)] = std::min(ri, rj);
+	}
+
+	//perfectly inelastic, mass and momentum are conserved
+	std::vector<double> mass(n, 0.0);
+	std::vector<Vec3> momentum(n), moment(n);
+	for (int i = 0; i < n; i++) {
+		int r = find(i);
+		mass[r] += bodies_[i].mass;
+		momentum[r] += bodies_[i].velocity * bodies_[i].mass;
+		moment[r] += bodies_[i].position * bodies_[i].mass;
+	}
 
-            auto gFinal = getGradientAtPoint(x, z);
-            if (std::hypot(gFinal.x, gFinal.z) < gradThreshold)
-                candidates.push_back({ x, 0.0, z });
-        }
-    }
+	std::vector<Body> merged;
+	for (int i = 0; i < n; i++) {
+		if (find(i) != i)
+			continue;
 
-    //deduplication
-    constexpr double mergeThreshold = 0.0001;
-    for (const auto& c : candidates) {
-        bool unique = true;
-        for (const auto& p : points) {
-            if (std::hypot(c.x - p.x, c.z - p.z) < mergeThreshold) {
-                unique = false;
-                break;
-            }
-        }
-        if (unique)
-            points.push_back(c);
-    }
+		Body b = bodies_[i];
+		if (mass[i] > 0.0 && mass[i] != b.mass) {
+			b.position = moment[i] / mass[i];
+			b.velocity = momentum[i] / mass[i];
+			b.mass = mass[i];
+			b.radius = std::pow(b.mass, 1 / 3.0);
+		}
+		merged.push_back(b);
+	}
 
-    for (auto& p : points)
-        p.y = -getPotentialAtPoint(p.x, p.z);
+	bodies_ = std::move(merged);
+	return true;
 }
 
+void GravitySimulator::computeAccelerationAndJerk(size_t i, const std::vector<Vec3>& pos, 
+	const std::vector<Vec3>& vel, Vec3& acc, Vec3& jerk) const
+{
+	constexpr double eps2 = 1e-12;
+	acc = Vec3(0, 0, 0);
+	jerk = Vec3(0, 0, 0);
+
+	for (size_t j = 0; j < bodies_.size(); j++) {
+		if (j == i || bodies_[j].mass == 0.0)
+			continue;
+
+		Vec3 r = pos[j] - pos[i];
+		Vec3 v = vel[j] - vel[i];
+		double dist2 = r.dot(r) + eps2;
+		double invDist = 1.0 / std::sqrt(dist2);
+		double invDist3 = invDist * invDist * invDist;
+		double rv = r.dot(v) / dist2;
+
+		acc += r * (G * bodies_[j].mass * invDist3);
+		jerk += (v - r * (3.0 * rv)) * (G * bodies_[j].mass * invDist3);
+	}
+}
 
 void GravitySimulator::computeAccelerations(std::vector<Vec3>& accels)
 {
-	constexpr double eps2 = 1e-12;
+	PROFILE_SCOPE("GravitySimulator::computeAccelerations");
 	const size_t n = bodies_.size();
 	accels.assign(n, Vec3{ 0.0, 0.0, 0.0 });
 
-	for (size_t i = 0; i < n; i++) {
-		for (size_t j = i + 1; j < n; j++) {
-			if (bodies_[j]->mass == 0.0 && bodies_[i]->mass == 0.0)
-				continue;
+	//massless bodies dont pull anything, padded with more massless
+	//sources to a multiple of the vector width
+	sources_.x.clear();
+	sources_.y.clear();
+	sources_.z.clear();
+	sources_.mass.clear();
+	for (const auto& b : bodies_) {
+		if (b.mass == 0.0)
+			continue;
 
-			Vec3 r = bodies_[j]->position - bodies_[i]->position;
-			double dist2 = r.dot(r) + eps2;
-			double invDist = 1.0 / std::sqrt(dist2);
-			double invDist3 = invDist * invDist * invDist;
+		sources_.x.push_back(b.position.x);
+		sources_.y.push_back(b.position.y);
+		sources_.z.push_back(b.position.z);
+		sources_.mass.push_back(b.mass);
+	}
+	while (sources_.mass.size() % 4 != 0) {
+		sources_.x.push_back(0.0);
+		sources_.y.push_back(0.0);
+		sources_.z.push_back(0.0);
+		sources_.mass.push_back(0.0);
+	}
+	const size_t sourceNum = sources_.mass.size();
+
+	//targets are split in blocks, each one sweeps over the sources one L1-sized tile at a time
+	//every target is owned by a single thread, so there are no scattered writes
+	const int blockNum = int((n + targetBlock - 1) / targetBlock);
+	#pragma omp parallel for schedule(static)
+	for (int block = 0; block < blockNum; block++) {
+		const size_t begin = block * targetBlock;
+		const size_t end = std::min(n, begin + targetBlock);
+		double ax[targetBlock] = {}, ay[targetBlock] = {}, az[targetBlock] = {};
+
+		for (size_t tile = 0; tile < sourceNum; tile += sourceTile) {
+			const size_t tileEnd = std::min(sourceNum, tile + sourceTile);
+
+			for (size_t i = begin; i < end; i++) {
+				const Vec3 p = bodies_[i].position;
+				accumulateTile(p.x, p.y, p.z, tile, tileEnd, ax[i - begin], ay[i - begin], az[i - begin]);
+			}
+		}
+
+		for (size_t i = begin; i < end; i++)
+			accels[i] = Vec3(ax[i - begin], ay[i - begin], az[i - begin]) * G;
+	}
+}
 
-			Vec3 forceDir = r * (G * invDist3);
-			accels[i] += forceDir * bodies_[j]->mass;
-			accels[j] -= forceDir * bodies_[i]->mass;
+void GravitySimulator::accumulateTile(double px, double py, double pz, size_t begin, size_t end,
+	double& ax, double& ay, double& az) const
+{
+	//softening, it also zeroes the pull of a body on itself
+	constexpr double eps2 = 1e-12;
+	size_t j = begin;
+
+#ifdef __AVX2__
+	const __m256d x = _mm256_set1_pd(px);
+	const __m256d y = _mm256_set1_pd(py);
+	const __m256d z = _mm256_set1_pd(pz);
+	const __m256d eps = _mm256_set1_pd(eps2);
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d threeHalves = _mm256_set1_pd(1.5);
+	__m256d sumX = _mm256_setzero_pd(), sumY = _mm256_setzero_pd(), sumZ = _mm256_setzero_pd();
+
+	//tiles are a multiple of the vector width
+	for (; j + 4 <= end; j += 4) {
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(sources_.x.data() + j), x);
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(sources_.y.data() + j), y);
+		__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(sources_.z.data() + j), z);
+		__m256d dist2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, eps)));
+
+		//single precision estimate refined with newton, each step doubles the correct bits
+		__m256d invDist = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(dist2)));
+		for (int k = 0; k < rsqrtRefinements; k++) {
+			__m256d e = _mm256_mul_pd(_mm256_mul_pd(half, dist2), _mm256_mul_pd(invDist, invDist));
+			invDist = _mm256_mul_pd(invDist, _mm256_sub_pd(threeHalves, e));
 		}
+
+		__m256d invDist3 = _mm256_mul_pd(invDist, _mm256_mul_pd(invDist, invDist));
+		__m256d k = _mm256_mul_pd(_mm256_loadu_pd(sources_.mass.data() + j), invDist3);
+		sumX = _mm256_fmadd_pd(k, dx, sumX);
+		sumY = _mm256_fmadd_pd(k, dy, sumY);
+		sumZ = _mm256_fmadd_pd(k, dz, sumZ);
+	}
+
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, sumX);
+	ax += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm256_store_pd(lanes, sumY);
+	ay += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm256_store_pd(lanes, sumZ);
+	az += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+	for (; j < end; j++) {
+		double dx = sources_.x[j] - px;
+		double dy = sources_.y[j] - py;
+		double dz = sources_.z[j] - pz;
+		double dist2 = dx * dx + dy * dy + dz * dz + eps2;
+		double invDist = 1.0 / std::sqrt(dist2);
+		double k = sources_.mass[j] * invDist * invDist * invDist;
+
+		ax += k * dx;
+		ay += k * dy;
+		az += k * dz;
 	}
 }
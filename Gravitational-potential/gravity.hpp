@@ -1,5 +1,7 @@
 #pragma once
 #include <SFML/System.hpp>
+#include <vector>
+#include <span>
 
 constexpr double PI = 3.14159265358979323846;
 typedef sf::Vector3<double> Vec3;
@@ -19,8 +21,9 @@ struct Body {
 
 	Vec3 position;
 	Vec3 velocity;
-	const double mass = 0;
-	const double radius = 1;
+	//not const since colliding bodies merge
+	double mass = 0;
+	double radius = 1;
 };
 
 struct Gradient {
@@ -35,6 +38,16 @@ struct Hessian {
 	double zz = 0;
 };
 
+enum class Integrator {
+	//kick-drift-kick, reuses the accelerations of the previous step
+	Leapfrog,
+	//symmetric compositions of leapfrog steps
+	Yoshida4,
+	Yoshida6,
+	//4th order predictor-corrector with individual block timesteps
+	Hermite
+};
+
 class GravitySimulator {
 public:
 	GravitySimulator(unsigned int fieldSideSize, unsigned int candidatesPerSide);
@@ -43,21 +56,106 @@ public:
 	Gradient getGradientAtPoint(double x, double z) const;
 	Hessian getHessianAtPoint(double x, double z) const;
 
+	//batched versions, the i-th output is evaluated at (xs[i], zs[i])
+	void evaluatePotential(std::span<const double> xs, std::span<const double> zs, std::span<double> out) const;
+	void evaluateGradient(std::span<const double> xs, std::span<const double> zs, 
+		std::span<double> outX, std::span<double> outZ) const;
+
+	//full 3D field, the queries above are on the y = 0 plane and ignore the height of the bodies
+	double getPotentialAt(const Vec3& p) const;
+	Vec3 getGradientAt(const Vec3& p) const;
+	void evaluatePotential(std::span<const double> xs, std::span<const double> ys, 
+		std::span<const double> zs, std::span<double> out) const;
+
 	void step(double dt);
+	void setIntegrator(Integrator integrator) {
+		integrator_ = integrator;
+		accelsValid_ = false;
+		hermiteValid_ = false;
+	}
+	Integrator getIntegrator() const { return integrator_; }
 
-	void addBodies(std::vector<Body>& bodies) {
-		for (auto& body : bodies)
-			bodies_.push_back(&body);
+	void addBodies(const std::vector<Body>& bodies) {
+		bodies_.insert(bodies_.end(), bodies.begin(), bodies.end());
+		accelsValid_ = false;
+		hermiteValid_ = false;
+		syncBodyStorage();
 	}
-	void calculateStabilityPoints(std::vector<Vec3>& points) const;
+	//bodies can merge during a step, so the vector can shrink
+	const std::vector<Body>& getBodies() const { return bodies_; }
+	void calculateStabilityPoints(std::vector<Vec3>& points);
+	//changes every time the bodies with mass move, so that cached field samples can be invalidated
+	unsigned long long getFieldVersion() const { return fieldVersion_; }
+	//lower bound of the potential everywhere, reached only if all the masses overlapped
+	double getPotentialFloor() const;
+	static double getPotentialScaling() { return potentialScaling; }
+	static double getG() { return G; }
 
 private:
+	void leapfrogStep(double dt);
+	void hermiteStep(double dt);
+	//merge the overlapping bodies, returns true if any did
+	bool resolveCollisions();
 	void computeAccelerations(std::vector<Vec3>& accels);
+	//adds the pull of the sources in [begin, end) on the point (px, py, pz), without G
+	void accumulateTile(double px, double py, double pz, size_t begin, size_t end,
+		double& ax, double& ay, double& az) const;
+	//acceleration and jerk of body i, from the positions and velocities in pos and vel
+	void computeAccelerationAndJerk(size_t i, const std::vector<Vec3>& pos, 
+		const std::vector<Vec3>& vel, Vec3& acc, Vec3& jerk) const;
+	//refresh the packed copy of the bodies after they moved
+	void syncBodyStorage();
+
+	void sampleStabilityGrid();
+	void findStabilityCandidates(std::vector<std::pair<int, Vec3>>& candidates) const;
+	//damped newton towards a zero of the gradient, returns false if it didnt converge
+	bool refineStabilityPoint(double& x, double& z) const;
+	//largest displacement of a body with mass since the last grid sampling
+	double bodiesMovedSinceSampling() const;
+
+	std::vector<Body> bodies_;
+	//packed (SoA) copy of the bodies with mass, read by the field queries
+	struct {
+		std::vector<double> x, y, z, mass, radius;
+	} massive_;
+	unsigned long long fieldVersion_ = 0;
+	//packed positions of the bodies with mass, the sources of the force kernel
+	struct {
+		std::vector<double> x, y, z, mass;
+	} sources_;
+
+	Integrator integrator_ = Integrator::Leapfrog;
+	//accelerations at the current positions, valid between leapfrog steps
+	std::vector<Vec3> accels_;
+	bool accelsValid_ = false;
+
+	//hermite state, body times are in ticks of the current step
+	struct HermiteBody {
+		Vec3 acc, jerk;
+		long long tick = 0;
+		long long stepTicks = 0;
+	};
+	std::vector<HermiteBody> hermite_;
+	bool hermiteValid_ = false;
+	double hermiteDt_ = 0;
+	//the smallest block timestep is dt / 2^maxBlockLevel
+	static constexpr int maxBlockLevel = 20;
+	static constexpr double hermiteEta = 0.02;
+
+	//force kernel blocking, a tile of sources is 4 arrays of 8 byte values
+	static constexpr size_t targetBlock = 64;
+	static constexpr size_t sourceTile = 512;
+	static constexpr int rsqrtRefinements = 2;
 
-	std::vector<Body*> bodies_;
+	//gradient grid of the last full stability search
+	std::vector<Gradient> stabilitySamples_;
+	std::vector<double> sampledX_, sampledZ_;
+	std::vector<Vec3> lastStabilityPoints_;
 
 	static constexpr double G = 50;
 	static constexpr double potentialScaling = 0.05;
+	//fraction of a grid cell the bodies can move before the grid is resampled
+	static constexpr double reuseDistance = 0.25;
 
 	const int fieldSideSize_;
 	const int candidatesPerSide_;
@@ -1,82 +1,211 @@
 #include "engine.hpp"
 #include "gravity.hpp"
+#include "snapshot.hpp"
+#include "scenarios.hpp"
+#include "profiler.hpp"
+#include "progress.hpp"
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <cmath>
 
-int main() {
+//size of the headless captures, capture_<step>.png
+static const sf::Vector2u captureSize(1280, 720);
+
+//integrate as fast as possible, without a window
+//captures, if any, are drawn by the cpu rasterizer from the default camera
+static int runHeadless(GravitySimulator& sim, double simTime, double dt, 
+	size_t snapshotEvery, const std::string& output, size_t captureEvery) 
+{
+	SnapshotWriter writer(output);
+	if (!writer.isOpen()) {
+		std::cout << "cannot open " << output << "\n";
+		return -1;
+	}
+
+	std::vector<Vec3> stabilityPoints;
+	const size_t steps = size_t(std::ceil(simTime / dt));
+	auto t0 = std::chrono::steady_clock::now();
+	ProgressReporter progress("steps", steps);
+
+	//the engine only provides the camera here, no window is created
+	std::unique_ptr<Engine3D> engine;
+	if (captureEvery > 0)
+		engine = std::make_unique<Engine3D>(60, 500, 50);
+
+	for (size_t i = 0; i <= steps; i++) {
+		//stability points are only needed for the snapshots
+		if (i % snapshotEvery == 0 || i == steps) {
+			sim.calculateStabilityPoints(stabilityPoints);
+			writer.write(i * dt, sim.getBodies(), stabilityPoints);
+		}
+		if (engine && (i % captureEvery == 0 || i == steps)) {
+			sf::Image capture(captureSize, sf::Color(10, 10, 10));
+			engine->rasterizeBodies(sim.getBodies(), capture);
+			std::ostringstream name;
+			name << "capture_" << std::setw(6) << std::setfill('0') << i << ".png";
+			if (!capture.saveToFile(name.str()))
+				std::cout << "cannot write " << name.str() << "\n";
+		}
+		if (i < steps) {
+			sim.step(dt);
+			progress.add(1);
+		}
+	}
+	progress.finish();
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	std::cout << "simulated " << steps * dt << "s in " << elapsed << "s (" << 
+		steps / elapsed << " steps/s), " << sim.getBodies().size() << " bodies left\n";
+	Profiler::exportRequestedTrace();
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
 	GravitySimulator sim(500, 99 * 4);
 
+	//usage: [--headless <sim time>] [--dt <step>] [--snapshot-every <steps>] [--output <file>]
+	//       [--capture-every <steps>]
+	//       [--scenario <plummer|disc|kepler>] [--n <bodies>] [--seed <seed>]
+	double simTime = -1;
+	double dt = 1.0 / 60;
+	size_t snapshotEvery = 60;
+	std::string output = "snapshots.bin";
+	size_t captureEvery = 0;
+	std::string scenario;
+	size_t n = 10000;
+	uint64_t seed = 1;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--headless")
+			simTime = std::stod(argv[i + 1]);
+		else if (arg == "--dt")
+			dt = std::stod(argv[i + 1]);
+		else if (arg == "--snapshot-every")
+			snapshotEvery = std::max(1ull, std::stoull(argv[i + 1]));
+		else if (arg == "--capture-every")
+			captureEvery = std::stoull(argv[i + 1]);
+		else if (arg == "--output")
+			output = argv[i + 1];
+		else if (arg == "--scenario")
+			scenario = argv[i + 1];
+		else if (arg == "--n")
+			n = std::max(1ull, std::stoull(argv[i + 1]));
+		else if (arg == "--seed")
+			seed = std::stoull(argv[i + 1]);
+		else
+			std::cout << "unknown option " << arg << "\n";
+	}
+
+	//scenarios are sized to fit the default view
+	if (scenario == "plummer")
+		sim.addBodies(Scenario::plummerSphere(n, 1000, 30, seed));
+	else if (scenario == "disc")
+		sim.addBodies(Scenario::exponentialDisc(n, 200, 40, 500, seed));
+	else if (scenario == "kepler")
+		sim.addBodies(Scenario::keplerianSystem(n, 500, 0.01, 30, 200, seed));
+	else {
+		if (!scenario.empty())
+			std::cout << "unknown scenario " << scenario << "\n";
+		sim.addBodies({ 
+			Body({ 0, 0, 0 }, { 21.0 / 25, 0, 0 }, 500),
+			Body({ 0, 0, 80 }, { 18, 0, 0 }, 10),
+			Body({ 0, 0, 70 }, { 25, 0, 0 }),
+			Body({ 0, 0, -85 }, { -20, 0, 0 }, 30)
+		});
+	}
+
+	if (simTime >= 0)
+		return runHeadless(sim, simTime, dt, snapshotEvery, output, captureEvery);
+
+	//the fps breakdown in the console comes from the profiler totals
+	Profiler::setEnabled(true);
 	std::vector<Vec3> stabilityPoints;
-	std::vector<Body> bodies = { 
-		Body({ 0, 0, 0 }, { 21.0 / 25, 0, 0 }, 500),
-		Body({ 0, 0, 80 }, { 18, 0, 0 }, 10),
-		Body({ 0, 0, 70 }, { 25, 0, 0 }),
-		Body({ 0, 0, -85 }, { -20, 0, 0 }, 30)
-	};
-	sim.addBodies(bodies);
 	sim.calculateStabilityPoints(stabilityPoints);
 
 	bool isRunning = false;
+	bool showVolume = false;
 	const unsigned int fps = 60;
 	Engine3D engine(fps, 500, 50);
 	const float width = sf::VideoMode::getFullscreenModes()[0].size.x * 2 / 3.f;
 	auto& window = engine.createWindow(sf::Vector2u(width, width * 9.f / 16.f));
 
-	using namespace std::chrono;
-	size_t totTime = 0;
-	size_t fieldTime = 0;
-	size_t stabTime = 0;
-	size_t idleTime = 0;
-
 	size_t frame = 0;
 	while (window.isOpen()) {
-		auto t0 = system_clock::now();
+		PROFILE_SCOPE("frame");
 		int status = engine.handleEvents();
 		if (status == 1)
 			isRunning = !isRunning;
+		else if (status == 2) {
+			const char* names[] = { "leapfrog", "yoshida 4", "yoshida 6", "hermite" };
+			sim.setIntegrator(Integrator((int(sim.getIntegrator()) + 1) % 4));
+			std::cout << "integrator: " << names[int(sim.getIntegrator())] << "\n";
+		}
+		else if (status == 3) {
+			sf::Image capture(window.getSize(), sf::Color(10, 10, 10));
+			engine.rasterizeBodies(sim.getBodies(), capture);
+			auto _ = capture.saveToFile("capture.png");
+		}
+		else if (status == 4)
+			showVolume = !showVolume;
 
 		//fast for small N
 		if (isRunning)
 			sim.step(1.0 / fps);
 
 		window.clear(sf::Color(10, 10, 10));
-		
-		auto t = system_clock::now();
-		engine.renderPotentialField(sim);
-		fieldTime += duration_cast<microseconds>(system_clock::now() - t).count();
+		if (showVolume)
+			engine.renderFieldVolume(sim);
+		else
+			engine.renderPotentialField(sim);
+		engine.renderBodies(sim.getBodies());
 
-		//extremely fast
-		engine.renderBodies(bodies);
-
-		t = system_clock::now();
 		if (isRunning)
 			sim.calculateStabilityPoints(stabilityPoints);
-		stabTime += duration_cast<microseconds>(system_clock::now() - t).count();
-
-		//extremely fast
 		engine.renderPoints(stabilityPoints);
 
 		//actual displaying is fast, also handles idling
-		t = system_clock::now();
-		window.display();
-		idleTime += duration_cast<microseconds>(system_clock::now() - t).count();
-		totTime += duration_cast<microseconds>(system_clock::now() - t0).count();
+		{
+			PROFILE_SCOPE("display");
+			window.display();
+		}
 
 		if (++frame % (2 * fps) == 0) {
-			std::string actualFps = std::format("{:.2f}", 2 * fps * 1'000'000.f / totTime);
-			std::string fieldPer = std::format("{:.2f}", 100 * float(fieldTime) / totTime);
-			std::string stabPer = std::format("{:.2f}", 100 * float(stabTime) / totTime);
-			std::string idlePer = std::format("{:.2f}", 100 * float(idleTime) / totTime);
-			totTime = 0, fieldTime = 0, stabTime = 0, idleTime = 0;
-			std::cout << "fps: " << actualFps << " - field: " << fieldPer << 
-				"%, stability: " << stabPer << "%, idle: " << idlePer << "%\n";
+			//the frame scope of this frame is still open, it will be in the next batch
+			auto totals = Profiler::collectTotals();
+			auto total = [&](const char* name) {
+				for (const auto& [n, t] : totals)
+					if (n == name)
+						return t;
+				return 0.0;
+				};
+
+			double frameTime = total("frame");
+			const std::pair<const char*, const char*> phases[] = {
+				{ "events", "Engine3D::handleEvents" },
+				{ "physics", "GravitySimulator::step" },
+				{ "field", showVolume ? "Engine3D::renderFieldVolume" : "Engine3D::renderPotentialField" },
+				{ "bodies", "Engine3D::renderBodies" },
+				{ "stability", "GravitySimulator::calculateStabilityPoints" },
+				{ "idle", "display" }
+			};
+
+			std::cout << "fps: " << std::format("{:.2f}", 2 * fps / frameTime);
+			for (const auto& [label, name] : phases)
+				std::cout << ", " << label << ": " << std::format("{:.2f}", 100 * total(name) / frameTime) << "%";
+			std::cout << "\n";
 
 			//Vec3 momentum(0, 0, 0);
-			//for (const auto& b : bodies)
+			//for (const auto& b : sim.getBodies())
 			//	momentum += b.mass * b.velocity;
 			//std::cout << "momentum: <" << momentum.x << ", " << momentum.y << ", " << momentum.z << ">\n";
 		}
 	}
 
+	Profiler::exportRequestedTrace();
 	return 0;
-}
\ No newline at end of file
+}
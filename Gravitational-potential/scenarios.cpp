@@ -0,0 +1,140 @@
+#include "scenarios.hpp"
+#include <cmath>
+
+Scenario::Random::Random(uint64_t seed, uint64_t stream)
+	:
+	state_(seed ^ (stream * 0x9E3779B97F4A7C15ull))
+{
+	next();
+}
+
+uint64_t Scenario::Random::next()
+{
+	//splitmix64
+	uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+double Scenario::Random::uniform()
+{
+	return (next() >> 11) * 0x1.0p-53;
+}
+
+double Scenario::Random::normal()
+{
+	//box-muller, 1 - u keeps the log finite
+	double u1 = 1.0 - uniform(), u2 = uniform();
+	return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * PI * u2);
+}
+
+Vec3 Scenario::Random::unitVector()
+{
+	double y = 2.0 * uniform() - 1.0;
+	double phi = 2.0 * PI * uniform();
+	double s = std::sqrt(1.0 - y * y);
+	return Vec3(s * std::cos(phi), y, s * std::sin(phi));
+}
+
+template<typename F>
+std::vector<Body> Scenario::generate(size_t n, uint64_t seed, F makeBody)
+{
+	std::vector<Body> bodies(n, Body(Vec3(), Vec3()));
+	const int chunks = int((n + chunkSize - 1) / chunkSize);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunks; c++) {
+		Random rng(seed, c);
+		for (size_t i = c * chunkSize; i < std::min(n, (c + 1) * chunkSize); i++)
+			bodies[i] = makeBody(rng);
+	}
+
+	return bodies;
+}
+
+std::vector<Body> Scenario::plummerSphere(size_t n, double totalMass, double scaleRadius, uint64_t seed)
+{
+	const double G = GravitySimulator::getG();
+	const double m = totalMass / n;
+
+	//aarseth, henon, wielen (1974)
+	return generate(n, seed, [=](Random& rng) {
+		//inverse of the cumulative mass, the outer 0.1% is cut off
+		double x = 0.999 * rng.uniform() + 1e-9;
+		double r = scaleRadius / std::sqrt(std::pow(x, -2.0 / 3.0) - 1.0);
+
+		//speed as a fraction of the escape speed, by rejection from q^2 (1 - q^2)^3.5
+		double q = 0.0;
+		do {
+			q = rng.uniform();
+		} while (0.1 * rng.uniform() >= q * q * std::pow(1.0 - q * q, 3.5));
+		double escape = std::sqrt(2.0 * G * totalMass / scaleRadius) * std::pow(1.0 + r * r / (scaleRadius * scaleRadius), -0.25);
+
+		Vec3 position = rng.unitVector() * r;
+		Vec3 velocity = rng.unitVector() * (q * escape);
+		return Body(position, velocity, m);
+		});
+}
+
+std::vector<Body> Scenario::exponentialDisc(size_t n, double discMass, double scaleLength, 
+	double centralMass, uint64_t seed)
+{
+	const double G = GravitySimulator::getG();
+	const double m = discMass / n;
+
+	auto bodies = generate(n, seed, [=](Random& rng) {
+		//R * exp(-R / Rd) is a gamma(2, Rd) distribution
+		double R = -scaleLength * std::log((1.0 - rng.uniform()) * (1.0 - rng.uniform()));
+		double phi = 2.0 * PI * rng.uniform();
+		double height = 0.02 * scaleLength * rng.normal();
+
+		//circular speed of the mass inside R, taken as if it was spherical
+		double inside = centralMass + discMass * (1.0 - (1.0 + R / scaleLength) * std::exp(-R / scaleLength));
+		double speed = std::sqrt(G * inside / R) * (1.0 + 0.05 * rng.normal());
+
+		Vec3 position(R * std::cos(phi), height, R * std::sin(phi));
+		Vec3 velocity(-speed * std::sin(phi), 0.0, speed * std::cos(phi));
+		return Body(position, velocity, m);
+		});
+
+	if (centralMass > 0.0)
+		bodies.insert(bodies.begin(), Body(Vec3(), Vec3(), centralMass));
+	return bodies;
+}
+
+std::vector<Body> Scenario::keplerianSystem(size_t n, double centralMass, double bodyMass,
+	double minRadius, double maxRadius, uint64_t seed)
+{
+	const double mu = GravitySimulator::getG() * centralMass;
+	constexpr double maxEccentricity = 0.1;
+	constexpr double maxInclination = 0.05;
+
+	auto bodies = generate(n, seed, [=](Random& rng) {
+		double a = minRadius * std::pow(maxRadius / minRadius, rng.uniform());
+		double e = maxEccentricity * rng.uniform();
+		double inclination = maxInclination * rng.normal();
+		double periapsis = 2.0 * PI * rng.uniform();
+		double anomaly = 2.0 * PI * rng.uniform();
+
+		//orbit on its own plane, from the true anomaly
+		double p = a * (1.0 - e * e);
+		double r = p / (1.0 + e * std::cos(anomaly));
+		double vr = std::sqrt(mu / p) * e * std::sin(anomaly);
+		double vt = std::sqrt(mu / p) * (1.0 + e * std::cos(anomaly));
+
+		double angle = anomaly + periapsis;
+		double u = r * std::cos(angle), w = r * std::sin(angle);
+		double vu = vr * std::cos(angle) - vt * std::sin(angle);
+		double vw = vr * std::sin(angle) + vt * std::cos(angle);
+
+		//tilt the orbital plane out of xz
+		double ci = std::cos(inclination), si = std::sin(inclination);
+		Vec3 position(u, w * si, w * ci);
+		Vec3 velocity(vu, vw * si, vw * ci);
+		return bodyMass > 0.0 ? Body(position, velocity, bodyMass) : Body(position, velocity);
+		});
+
+	bodies.insert(bodies.begin(), Body(Vec3(), Vec3(), centralMass));
+	return bodies;
+}
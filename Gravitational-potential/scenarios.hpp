@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include "gravity.hpp"
+
+//initial conditions for large systems, generated in parallel
+//the same seed always gives the same bodies, whatever the number of threads
+class Scenario {
+public:
+	//isotropic plummer sphere in virial equilibrium
+	static std::vector<Body> plummerSphere(size_t n, double totalMass, double scaleRadius, uint64_t seed);
+	//thin disc on the xz plane with surface density exp(-R / scaleLength), 
+	//around a central mass, on nearly circular orbits
+	static std::vector<Body> exponentialDisc(size_t n, double discMass, double scaleLength, 
+		double centralMass, uint64_t seed);
+	//bodies on random low eccentricity orbits around a central mass,
+	//semi-major axes log-uniform between minRadius and maxRadius
+	static std::vector<Body> keplerianSystem(size_t n, double centralMass, double bodyMass,
+		double minRadius, double maxRadius, uint64_t seed);
+
+private:
+	//small generator with an explicit algorithm, unlike the std distributions
+	//its output is the same on every standard library
+	class Random {
+	public:
+		Random(uint64_t seed, uint64_t stream);
+		uint64_t next();
+		//uniform in [0, 1)
+		double uniform();
+		double normal();
+		Vec3 unitVector();
+
+	private:
+		uint64_t state_;
+	};
+
+	//bodies are made in chunks, each with its own random stream
+	template<typename F>
+	static std::vector<Body> generate(size_t n, uint64_t seed, F makeBody);
+
+	static constexpr size_t chunkSize = 4096;
+};
@@ -0,0 +1,78 @@
+#include "snapshot.hpp"
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+	:
+	file_(path, std::ios::binary)
+{
+	file_.write("NBODYSNP", 8);
+	file_.write(reinterpret_cast<const char*>(&version), sizeof(version));
+
+	writer_ = std::thread(&SnapshotWriter::writerLoop, this);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	{
+		std::lock_guard lock(mutex_);
+		stop_ = true;
+	}
+	cv_.notify_all();
+	writer_.join();
+}
+
+void SnapshotWriter::write(double time, const std::vector<Body>& bodies, const std::vector<Vec3>& points)
+{
+	//packing happens on the simulation thread, outside of the lock
+	front_.time = time;
+	front_.bodyNum = bodies.size();
+	front_.pointNum = points.size();
+	front_.data.resize(7 * bodies.size() + 3 * points.size());
+
+	const size_t n = bodies.size();
+	double* d = front_.data.data();
+	for (size_t i = 0; i < n; i++) {
+		const auto& b = bodies[i];
+		d[i] = b.position.x;
+		d[n + i] = b.position.y;
+		d[2 * n + i] = b.position.z;
+		d[3 * n + i] = b.velocity.x;
+		d[4 * n + i] = b.velocity.y;
+		d[5 * n + i] = b.velocity.z;
+		d[6 * n + i] = b.mass;
+	}
+	d += 7 * n;
+	for (const auto& p : points) {
+		*d++ = p.x;
+		*d++ = p.y;
+		*d++ = p.z;
+	}
+
+	std::unique_lock lock(mutex_);
+	cv_.wait(lock, [this] { return !pending_; });
+	std::swap(front_, back_);
+	pending_ = true;
+	lock.unlock();
+	cv_.notify_all();
+}
+
+void SnapshotWriter::writerLoop()
+{
+	std::unique_lock lock(mutex_);
+	while (true) {
+		cv_.wait(lock, [this] { return pending_ || stop_; });
+		if (!pending_)
+			break;
+
+		//back_ is owned by this thread until pending_ is cleared
+		lock.unlock();
+		file_.write(reinterpret_cast<const char*>(&back_.time), sizeof(back_.time));
+		file_.write(reinterpret_cast<const char*>(&back_.bodyNum), sizeof(back_.bodyNum));
+		file_.write(reinterpret_cast<const char*>(&back_.pointNum), sizeof(back_.pointNum));
+		file_.write(reinterpret_cast<const char*>(back_.data.data()), back_.data.size() * sizeof(double));
+		lock.lock();
+
+		pending_ = false;
+		cv_.notify_all();
+	}
+	file_.flush();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "gravity.hpp"
+
+//streams the state of the simulation to a binary file from a background thread
+//file layout (little endian):
+//  header: "NBODYSNP", uint32 version
+//  per snapshot: double time, uint64 bodies, uint64 points,
+//  then the doubles x[], y[], z[], vx[], vy[], vz[], mass[] of the bodies
+//  and x, y, z of each stability point
+class SnapshotWriter {
+public:
+	SnapshotWriter(const std::string& path);
+	//writes the pending snapshot before closing the file
+	~SnapshotWriter();
+
+	bool isOpen() const { return file_.is_open(); }
+	//copies the state and returns, it only waits if the previous snapshot is still being written
+	void write(double time, const std::vector<Body>& bodies, const std::vector<Vec3>& points);
+
+private:
+	struct Snapshot {
+		double time = 0;
+		uint64_t bodyNum = 0;
+		uint64_t pointNum = 0;
+		std::vector<double> data;
+	};
+
+	void writerLoop();
+
+	std::ofstream file_;
+	//the simulation fills front_ while the writer thread drains back_
+	Snapshot front_, back_;
+	bool pending_ = false;
+	bool stop_ = false;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::thread writer_;
+
+	static constexpr uint32_t version = 1;
+};
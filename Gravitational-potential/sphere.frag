@@ -1,13 +1,9 @@
 uniform vec3 lightDir;   // Direction towards the light
-uniform vec3 baseColor;  // Sphere color
-
-uniform float radius;
-uniform vec2 pos;
 
 void main()
 {
-    //pixels mapped [-1,1]
-    vec2 p = (gl_FragCoord.xy - pos) / radius;
+    //pixels mapped [-1,1] by the quad texture coordinates
+    vec2 p = gl_TexCoord[0].xy;
 
     float r2 = dot(p, p);
     if (r2 > 1.0) discard;
@@ -18,7 +14,8 @@ void main()
     vec3 l = normalize(lightDir);
     float diff = max(dot(normal, l), 0.05);
     
-    vec3 color = baseColor * diff;
+    //sphere color is the vertex color
+    vec3 color = gl_Color.rgb * diff;
     color = pow(color, vec3(1.0 / 2.2));
     gl_FragColor = vec4(color, 1);
 }
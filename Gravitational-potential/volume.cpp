@@ -0,0 +1,221 @@
+#include "volume.hpp"
+#include "profiler.hpp"
+#include <cmath>
+#include <algorithm>
+#include <bit>
+
+FieldVolume::FieldVolume(double size, int bricksPerSide, int brickCells)
+	:
+	bricksPerSide_(bricksPerSide),
+	brickCells_(brickCells)
+{
+	const double brickSize = size / bricksPerSide;
+	const double h = size / 2.0;
+	for (int k = 0; k < bricksPerSide; k++) {
+		for (int j = 0; j < bricksPerSide; j++) {
+			for (int i = 0; i < bricksPerSide; i++) {
+				Brick brick;
+				brick.min = Vec3(-h + i * brickSize, -h + j * brickSize, -h + k * brickSize);
+				brick.max = brick.min + Vec3(brickSize, brickSize, brickSize);
+				bricks_.push_back(std::move(brick));
+			}
+		}
+	}
+}
+
+void FieldVolume::setLevels(const std::vector<double>& levels)
+{
+	//bricks without samples may have a new level crossing them
+	levels_ = levels;
+	for (auto& brick : bricks_)
+		brick.isSampled = false;
+}
+
+int FieldVolume::getStoredBricks() const
+{
+	return int(std::count_if(bricks_.begin(), bricks_.end(), [](const Brick& b) {
+		return !b.samples.empty();
+		}));
+}
+
+int FieldVolume::update(const GravitySimulator& sim)
+{
+	PROFILE_SCOPE("FieldVolume::update");
+	std::vector<Source> sources;
+	for (const auto& b : sim.getBodies())
+		if (b.mass > 0.0)
+			sources.push_back({ b.position, b.mass, b.radius });
+
+	//merges change the masses, the bound below only covers bodies that moved
+	bool sameBodies = sources.size() == sources_.size();
+	for (size_t s = 0; sameBodies && s < sources.size(); s++)
+		sameBodies = sources[s].mass == sources_[s].mass;
+
+	if (!sameBodies) {
+		for (auto& brick : bricks_)
+			brick.isSampled = false;
+	}
+	else if (sim.getFieldVersion() != fieldVersion_) {
+		const double scale = GravitySimulator::getG() * GravitySimulator::getPotentialScaling();
+
+		//a body moving by d changes the potential by at most d times the largest gradient along its path,
+		//and the gradient of the softened potential is at most G m / max(r, R)^2
+		#pragma omp parallel for schedule(static)
+		for (int b = 0; b < int(bricks_.size()); b++) {
+			auto& brick = bricks_[b];
+			if (!brick.isSampled)
+				continue;
+
+			for (size_t s = 0; s < sources.size(); s++) {
+				const Vec3& p = sources[s].position;
+				double d = (p - sources_[s].position).length();
+				if (d == 0.0)
+					continue;
+
+				Vec3 outside(
+					std::max({ brick.min.x - p.x, 0.0, p.x - brick.max.x }),
+					std::max({ brick.min.y - p.y, 0.0, p.y - brick.max.y }),
+					std::max({ brick.min.z - p.z, 0.0, p.z - brick.max.z }));
+				double reach = std::max(outside.length() - d, sources[s].radius);
+				brick.drift += scale * sources[s].mass * d / (reach * reach);
+			}
+		}
+	}
+	sources_ = std::move(sources);
+	fieldVersion_ = sim.getFieldVersion();
+
+	std::vector<int> dirty;
+	for (int b = 0; b < int(bricks_.size()); b++)
+		if (needsResample(bricks_[b]))
+			dirty.push_back(b);
+	if (dirty.empty())
+		return 0;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int d = 0; d < int(dirty.size()); d++) {
+		auto& brick = bricks_[dirty[d]];
+		sampleBrick(brick, sim);
+		extractBrick(brick);
+	}
+
+	triangles_.clear();
+	for (const auto& brick : bricks_)
+		triangles_.insert(triangles_.end(), brick.triangles.begin(), brick.triangles.end());
+	version_++;
+
+	return int(dirty.size());
+}
+
+bool FieldVolume::needsResample(const Brick& brick) const
+{
+	if (!brick.isSampled)
+		return true;
+	if (!brick.samples.empty())
+		return brick.drift > driftTolerance;
+
+	//empty bricks only matter once a level could have entered their range
+	for (double level : levels_)
+		if (level >= brick.minPotential - brick.drift && level <= brick.maxPotential + brick.drift)
+			return true;
+	return false;
+}
+
+void FieldVolume::sampleBrick(Brick& brick, const GravitySimulator& sim) const
+{
+	const int side = brickCells_ + 1;
+	const int count = side * side * side;
+	const Vec3 cell = (brick.max - brick.min) / double(brickCells_);
+
+	std::vector<double> xs(count), ys(count), zs(count), potential(count);
+	for (int k = 0, n = 0; k < side; k++) {
+		for (int j = 0; j < side; j++) {
+			for (int i = 0; i < side; i++, n++) {
+				xs[n] = brick.min.x + i * cell.x;
+				ys[n] = brick.min.y + j * cell.y;
+				zs[n] = brick.min.z + k * cell.z;
+			}
+		}
+	}
+	sim.evaluatePotential(xs, ys, zs, potential);
+
+	auto [lo, hi] = std::minmax_element(potential.begin(), potential.end());
+	brick.minPotential = *lo;
+	brick.maxPotential = *hi;
+	brick.drift = 0;
+	brick.isSampled = true;
+
+	bool isCrossed = false;
+	for (double level : levels_)
+		isCrossed |= level >= brick.minPotential && level <= brick.maxPotential;
+
+	//sparse storage, only the min and max are kept for the rest
+	if (isCrossed)
+		brick.samples.assign(potential.begin(), potential.end());
+	else
+		std::vector<float>().swap(brick.samples);
+}
+
+void FieldVolume::extractBrick(Brick& brick) const
+{
+	brick.triangles.clear();
+	if (brick.samples.empty())
+		return;
+
+	//the cube is split in 6 tetrahedra around its 0-7 diagonal, corner c is at (c & 1, c >> 1 & 1, c >> 2 & 1)
+	//neighbouring cubes split their shared faces the same way, so the surface has no cracks
+	static constexpr int tetrahedra[6][4] = {
+		{ 0, 1, 3, 7 }, { 0, 2, 3, 7 }, { 0, 2, 6, 7 },
+		{ 0, 4, 6, 7 }, { 0, 4, 5, 7 }, { 0, 1, 5, 7 }
+	};
+
+	const int side = brickCells_ + 1;
+	const Vec3 cell = (brick.max - brick.min) / double(brickCells_);
+
+	Vec3 p[8];
+	double v[8];
+	for (int k = 0; k < brickCells_; k++) {
+		for (int j = 0; j < brickCells_; j++) {
+			for (int i = 0; i < brickCells_; i++) {
+				for (int c = 0; c < 8; c++) {
+					int ci = i + (c & 1), cj = j + (c >> 1 & 1), ck = k + (c >> 2 & 1);
+					p[c] = brick.min + Vec3(ci * cell.x, cj * cell.y, ck * cell.z);
+					v[c] = brick.samples[(ck * side + cj) * side + ci];
+				}
+
+				for (int l = 0; l < int(levels_.size()); l++) {
+					const double level = levels_[l];
+					auto cut = [&](int a, int b) {
+						return p[a] + (p[b] - p[a]) * ((level - v[a]) / (v[b] - v[a]));
+						};
+
+					for (const auto& t : tetrahedra) {
+						int mask = 0;
+						for (int q = 0; q < 4; q++)
+							mask |= (v[t[q]] < level) << q;
+						if (mask == 0 || mask == 15)
+							continue;
+
+						int inside = std::popcount(unsigned(mask));
+						if (inside == 1 || inside == 3) {
+							//the corner on its own side against the other three
+							int odd = std::countr_zero(unsigned(inside == 1 ? mask : ~mask & 15));
+							int a = t[odd], b = t[(odd + 1) % 4], c = t[(odd + 2) % 4], d = t[(odd + 3) % 4];
+							brick.triangles.push_back({ cut(a, b), cut(a, c), cut(a, d), l });
+						}
+						else {
+							//two corners on each side, the surface is a quad
+							int a = -1, b = -1, c = -1, d = -1;
+							for (int q = 0; q < 4; q++) {
+								int& slot = (mask >> q & 1) ? (a < 0 ? a : b) : (c < 0 ? c : d);
+								slot = t[q];
+							}
+							Vec3 ac = cut(a, c), ad = cut(a, d), bd = cut(b, d), bc = cut(b, c);
+							brick.triangles.push_back({ ac, ad, bd, l });
+							brick.triangles.push_back({ ac, bd, bc, l });
+						}
+					}
+				}
+			}
+		}
+	}
+}
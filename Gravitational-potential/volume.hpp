@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include "gravity.hpp"
+
+//potential in a cube around the origin, stored as bricks of samples that are only
+//kept where an equipotential surface crosses them, and updated only where the field changed
+class FieldVolume {
+public:
+	struct Triangle {
+		Vec3 a, b, c;
+		//index of the level of the surface
+		int level = 0;
+	};
+
+	//cube of side size centered at the origin, made of bricksPerSide^3 bricks of brickCells^3 cells
+	FieldVolume(double size, int bricksPerSide, int brickCells);
+
+	//potentials of the surfaces to extract, in the same units as the field queries
+	void setLevels(const std::vector<double>& levels);
+	const std::vector<double>& getLevels() const { return levels_; }
+	//resample and extract the bricks where the field could have changed by more than the tolerance,
+	//returns the number of bricks that were resampled
+	int update(const GravitySimulator& sim);
+
+	//triangles of all the surfaces, changes only when getVersion does
+	const std::vector<Triangle>& getTriangles() const { return triangles_; }
+	unsigned long long getVersion() const { return version_; }
+	//number of bricks holding samples
+	int getStoredBricks() const;
+
+private:
+	struct Brick {
+		Vec3 min, max;
+		//potential at the (cells + 1)^3 corners, x fastest, empty if no surface crosses the brick
+		std::vector<float> samples;
+		double minPotential = 0, maxPotential = 0;
+		//bound on how much the potential changed anywhere in the brick since it was sampled
+		double drift = 0;
+		bool isSampled = false;
+		std::vector<Triangle> triangles;
+	};
+
+	//bodies with mass as seen by the last update
+	struct Source {
+		Vec3 position;
+		double mass, radius;
+	};
+
+	bool needsResample(const Brick& brick) const;
+	void sampleBrick(Brick& brick, const GravitySimulator& sim) const;
+	//marching tetrahedra over the cells of the brick
+	void extractBrick(Brick& brick) const;
+
+	std::vector<Brick> bricks_;
+	std::vector<double> levels_;
+	std::vector<Source> sources_;
+	unsigned long long fieldVersion_ = 0;
+
+	std::vector<Triangle> triangles_;
+	unsigned long long version_ = 0;
+
+	//largest change of the potential a brick can accumulate before it is resampled
+	static constexpr double driftTolerance = 0.02;
+
+	const int bricksPerSide_;
+	const int brickCells_;
+};
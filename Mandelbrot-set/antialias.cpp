@@ -0,0 +1,83 @@
+#include "antialias.hpp"
+#include "profiler.hpp"
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+EdgeSupersampler::EdgeSupersampler(unsigned width, unsigned height, size_t maxIter, int samplesPerPixel)
+    :
+    width_(width),
+    height_(height),
+    maxCount_(float(maxIter)),
+    samplesPerPixel_(samplesPerPixel)
+{
+}
+
+bool EdgeSupersampler::differs(float a, float b) const
+{
+    //in and out of the set, or far apart compared to the counts themselves
+    if ((a >= maxCount_) != (b >= maxCount_) || (a < 0.f) != (b < 0.f))
+        return true;
+    return std::abs(a - b) > threshold * (1.f + std::min(a, b));
+}
+
+std::vector<size_t> EdgeSupersampler::findEdges(const float* iterations) const
+{
+    PROFILE_SCOPE("EdgeSupersampler::findEdges");
+    std::vector<std::vector<size_t>> rows(height_);
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < int(height_); y++) {
+        for (unsigned x = 0; x < width_; x++) {
+            const size_t i = size_t(y) * width_ + x;
+            const float v = iterations[i];
+            bool isEdge = (x > 0 && differs(v, iterations[i - 1])) || (x + 1 < width_ && differs(v, iterations[i + 1])) ||
+                (y > 0 && differs(v, iterations[i - width_])) || (y + 1 < int(height_) && differs(v, iterations[i + width_]));
+            if (isEdge)
+                rows[y].push_back(i);
+        }
+    }
+
+    std::vector<size_t> edges;
+    for (const auto& row : rows)
+        edges.insert(edges.end(), row.begin(), row.end());
+    return edges;
+}
+
+Supersamples EdgeSupersampler::refine(const float* iterations, const TileRenderer::PixelKernel& kernel) const
+{
+    PROFILE_SCOPE("EdgeSupersampler::refine");
+    Supersamples result;
+    result.perPixel = samplesPerPixel_;
+    result.pixels = findEdges(iterations);
+    result.samples.resize(result.pixels.size() * samplesPerPixel_);
+
+    const int n = samplesPerPixel_;
+    const long long batches = (long long)((result.pixels.size() + batchPixels - 1) / batchPixels);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (long long batch = 0; batch < batches; batch++) {
+        thread_local std::vector<double> px, py;
+        px.clear();
+        py.clear();
+
+        const size_t begin = size_t(batch) * batchPixels, end = std::min(result.pixels.size(), begin + batchPixels);
+        for (size_t p = begin; p < end; p++) {
+            const size_t pixel = result.pixels[p];
+            //stratified in x and golden ratio steps in y, shifted by a hash of the pixel
+            //so that neighbouring pixels dont share the same pattern
+            uint64_t h = (pixel + 1) * 0x9E3779B97F4A7C15ull;
+            h = (h ^ (h >> 31)) * 0xBF58476D1CE4E5B9ull;
+            const double shiftX = double(h >> 40) / double(1ull << 24), shiftY = double(h & 0xFFFFFF) / double(1ull << 24);
+            for (int s = 0; s < n; s++) {
+                double ox = (s + shiftX) / n, oy = s * 0.6180339887498949 + shiftY;
+                px.push_back(double(pixel % width_) + ox - 0.5);
+                py.push_back(double(pixel / width_) + (oy - std::floor(oy)) - 0.5);
+            }
+        }
+
+        kernel(px.data(), py.data(), px.size(), &result.samples[begin * n]);
+    }
+
+    return result;
+}
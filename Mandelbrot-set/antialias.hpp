@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "tiles.hpp"
+
+//extra samples of the pixels on edges, as escape counts so that the coloring can still change
+struct Supersamples {
+    int perPixel = 0;
+    //index of every refined pixel, its samples are at samples[i * perPixel]
+    std::vector<size_t> pixels;
+    std::vector<float> samples;
+};
+
+//adaptive antialiasing: only the pixels whose escape count differs a lot from a neighbour's get
+//extra jittered samples, the smooth parts of the image keep their single sample
+//the colorizer then averages the colors of all the samples of a pixel
+class EdgeSupersampler {
+public:
+    EdgeSupersampler(unsigned width, unsigned height, size_t maxIter, int samplesPerPixel);
+
+    //width * height escape counts, row by row
+    Supersamples refine(const float* iterations, const TileRenderer::PixelKernel& kernel) const;
+
+private:
+    std::vector<size_t> findEdges(const float* iterations) const;
+    bool differs(float a, float b) const;
+
+    //relative difference of the counts past which two neighbours are on an edge
+    static constexpr float threshold = 0.1f;
+    //refined pixels per kernel call
+    static constexpr size_t batchPixels = 512;
+
+    const unsigned width_;
+    const unsigned height_;
+    const float maxCount_;
+    const int samplesPerPixel_;
+};
@@ -0,0 +1,160 @@
+#include "bigfloat.hpp"
+#include <cmath>
+#include <algorithm>
+#include <cctype>
+
+BigFloat::BigFloat(int fractionLimbs)
+    :
+    limbs_(fractionLimbs + 1, 0)
+{
+}
+
+BigFloat::BigFloat(double value, int fractionLimbs)
+    :
+    BigFloat(fractionLimbs)
+{
+    negative_ = value < 0;
+    value = std::abs(value);
+
+    double integer = std::floor(value);
+    limbs_.back() = uint32_t(integer);
+    value -= integer;
+    //exact, a double has at most 53 significant bits
+    for (int i = fractionLimbs - 1; i >= 0 && value > 0; i--) {
+        value *= 4294967296.0;
+        double limb = std::floor(value);
+        limbs_[i] = uint32_t(limb);
+        value -= limb;
+    }
+}
+
+BigFloat BigFloat::fromString(const std::string& text, int fractionLimbs)
+{
+    BigFloat result(fractionLimbs);
+    size_t pos = 0;
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+'))
+        result.negative_ = text[pos++] == '-';
+
+    uint32_t integer = 0;
+    for (; pos < text.size() && std::isdigit((unsigned char)text[pos]); pos++)
+        integer = integer * 10 + (text[pos] - '0');
+
+    //fraction from the last digit to the first, each step is (digit + fraction) / 10
+    if (pos < text.size() && text[pos] == '.') {
+        size_t end = ++pos;
+        while (end < text.size() && std::isdigit((unsigned char)text[end]))
+            end++;
+
+        for (size_t d = end; d-- > pos;) {
+            result.limbs_.back() = text[d] - '0';
+            uint64_t remainder = 0;
+            for (size_t i = result.limbs_.size(); i-- > 0;) {
+                uint64_t current = (remainder << 32) | result.limbs_[i];
+                result.limbs_[i] = uint32_t(current / 10);
+                remainder = current % 10;
+            }
+        }
+    }
+    result.limbs_.back() = integer;
+
+    return result;
+}
+
+int BigFloat::limbsFor(double resolution)
+{
+    //the orbit loses about a bit per doubling of the distance to the set, 64 bits cover it
+    int bits = int(std::ceil(-std::log2(resolution))) + 64;
+    return std::max(2, (bits + 31) / 32);
+}
+
+double BigFloat::toDouble() const
+{
+    //3 limbs are more than the 53 bits of a double
+    double value = 0.0;
+    double weight = 1.0;
+    for (size_t i = limbs_.size(); i-- > 0 && i + 3 >= limbs_.size();) {
+        value += limbs_[i] * weight;
+        weight /= 4294967296.0;
+    }
+    return negative_ ? -value : value;
+}
+
+int BigFloat::compareMagnitude(const BigFloat& a, const BigFloat& b)
+{
+    for (size_t i = a.limbs_.size(); i-- > 0;)
+        if (a.limbs_[i] != b.limbs_[i])
+            return a.limbs_[i] < b.limbs_[i] ? -1 : 1;
+    return 0;
+}
+
+BigFloat BigFloat::addSigned(const BigFloat& a, const BigFloat& b, bool negateB)
+{
+    const bool bNegative = b.negative_ != negateB;
+    BigFloat result(int(a.limbs_.size()) - 1);
+
+    if (a.negative_ == bNegative) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < a.limbs_.size(); i++) {
+            uint64_t sum = uint64_t(a.limbs_[i]) + b.limbs_[i] + carry;
+            result.limbs_[i] = uint32_t(sum);
+            carry = sum >> 32;
+        }
+        result.negative_ = a.negative_;
+        return result;
+    }
+
+    //different signs, the smaller magnitude is taken from the larger one
+    bool aLarger = compareMagnitude(a, b) >= 0;
+    const BigFloat& large = aLarger ? a : b;
+    const BigFloat& small = aLarger ? b : a;
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.limbs_.size(); i++) {
+        int64_t diff = int64_t(large.limbs_[i]) - small.limbs_[i] - borrow;
+        borrow = diff < 0;
+        result.limbs_[i] = uint32_t(diff + (borrow << 32));
+    }
+    result.negative_ = aLarger ? a.negative_ : bNegative;
+    return result;
+}
+
+BigFloat BigFloat::operator+(const BigFloat& other) const
+{
+    return addSigned(*this, other, false);
+}
+
+BigFloat BigFloat::operator-(const BigFloat& other) const
+{
+    return addSigned(*this, other, true);
+}
+
+BigFloat BigFloat::operator-() const
+{
+    BigFloat result = *this;
+    result.negative_ = !negative_;
+    return result;
+}
+
+BigFloat BigFloat::operator*(const BigFloat& other) const
+{
+    //schoolbook product, the limbs below the last fractional one are dropped
+    const size_t n = limbs_.size();
+    const size_t fraction = n - 1;
+    std::vector<uint32_t> product(2 * n, 0);
+    for (size_t i = 0; i < n; i++) {
+        if (limbs_[i] == 0)
+            continue;
+
+        uint64_t carry = 0;
+        for (size_t j = 0; j < n; j++) {
+            uint64_t t = uint64_t(limbs_[i]) * other.limbs_[j] + product[i + j] + carry;
+            product[i + j] = uint32_t(t);
+            carry = t >> 32;
+        }
+        product[i + n] = uint32_t(carry);
+    }
+
+    BigFloat result{ int(fraction) };
+    std::copy(product.begin() + fraction, product.begin() + fraction + n, result.limbs_.begin());
+    result.negative_ = negative_ != other.negative_;
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+
+//signed fixed point number with a 32 bit integer part and a chosen number of 32 bit fractional limbs
+//reference orbits stay below the escape radius, so a floating exponent isnt needed
+class BigFloat {
+public:
+    explicit BigFloat(int fractionLimbs = 2);
+    BigFloat(double value, int fractionLimbs);
+    //plain decimal notation, like "-0.7436438870371587047521915061"
+    static BigFloat fromString(const std::string& text, int fractionLimbs);
+    //fractional limbs needed to tell apart points the given distance apart, with margin for the iteration
+    static int limbsFor(double resolution);
+
+    double toDouble() const;
+    int getFractionLimbs() const { return int(limbs_.size()) - 1; }
+
+    BigFloat operator+(const BigFloat& other) const;
+    BigFloat operator-(const BigFloat& other) const;
+    BigFloat operator*(const BigFloat& other) const;
+    BigFloat operator-() const;
+
+private:
+    //adds or subtracts the magnitudes, keeping the sign of the result
+    static BigFloat addSigned(const BigFloat& a, const BigFloat& b, bool negateB);
+    static int compareMagnitude(const BigFloat& a, const BigFloat& b);
+
+    //magnitude, least significant limb first, the last limb is the integer part
+    std::vector<uint32_t> limbs_;
+    bool negative_ = false;
+};
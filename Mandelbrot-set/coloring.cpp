@@ -0,0 +1,139 @@
+#include "coloring.hpp"
+#include "profiler.hpp"
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+Colorizer::Colorizer(size_t maxIter, Palette palette)
+    :
+    maxCount_(float(maxIter))
+{
+    tone_.resize(maxIter + 1);
+    for (size_t n = 0; n <= maxIter; n++)
+        tone_[n] = float(std::pow(double(n) / maxIter, toneExponent));
+
+    //gradient stops, evenly spaced
+    std::vector<sf::Color> stops;
+    sf::Color inside;
+    switch (palette) {
+    case Palette::Ice:
+        stops = { sf::Color::Black, sf::Color::Cyan };
+        inside = sf::Color::White;
+        break;
+    case Palette::Fire:
+        stops = { sf::Color::Black, sf::Color(180, 20, 0), sf::Color(255, 160, 0), sf::Color(255, 255, 200) };
+        inside = sf::Color::Black;
+        break;
+    case Palette::Gray:
+        stops = { sf::Color::Black, sf::Color::White };
+        inside = sf::Color::Black;
+        break;
+    }
+
+    lut_.resize(gradientSize + 2);
+    for (int i = 0; i < gradientSize; i++) {
+        double x = double(i) / (gradientSize - 1) * (stops.size() - 1);
+        size_t s = std::min(size_t(x), stops.size() - 2);
+        double f = x - s;
+        auto mix = [&](uint8_t a, uint8_t b) { return uint8_t(std::lround(a + (b - a) * f)); };
+        lut_[i] = sf::Color(mix(stops[s].r, stops[s + 1].r), mix(stops[s].g, stops[s + 1].g), mix(stops[s].b, stops[s + 1].b));
+    }
+    lut_[gradientSize] = inside;
+    lut_[gradientSize + 1] = sf::Color::Red;
+}
+
+bool Colorizer::parsePalette(const std::string& name, Palette& palette)
+{
+    if (name == "ice")
+        palette = Palette::Ice;
+    else if (name == "fire")
+        palette = Palette::Fire;
+    else if (name == "gray")
+        palette = Palette::Gray;
+    else
+        return false;
+    return true;
+}
+
+void Colorizer::equalize(const float* iterations, size_t count)
+{
+    PROFILE_SCOPE("Colorizer::equalize");
+    const size_t bins = tone_.size() - 1;
+    std::vector<size_t> histogram(bins, 0);
+
+    //a histogram per thread, merged at the end
+    #pragma omp parallel
+    {
+        std::vector<size_t> local(bins, 0);
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < (long long)count; i++) {
+            float n = iterations[i];
+            if (n >= 0.f && n < maxCount_)
+                local[size_t(n)]++;
+        }
+        #pragma omp critical
+        for (size_t b = 0; b < bins; b++)
+            histogram[b] += local[b];
+    }
+
+    size_t total = 0;
+    for (size_t h : histogram)
+        total += h;
+    if (total == 0)
+        return;
+
+    //cumulative share of the pixels below each count
+    size_t below = 0;
+    for (size_t b = 0; b < bins; b++) {
+        tone_[b] = float(double(below) / total);
+        below += histogram[b];
+    }
+    tone_[bins] = 1.f;
+}
+
+void Colorizer::apply(const float* iterations, size_t count, uint8_t* pixels, int channels, 
+    const Supersamples* supersamples) const
+{
+    PROFILE_SCOPE("Colorizer::apply");
+    //blocks of lookups, no branches left but the ones the compiler turns into selects
+    constexpr long long blockSize = 4096;
+    const long long blocks = ((long long)count + blockSize - 1) / blockSize;
+
+    #pragma omp parallel for schedule(static)
+    for (long long block = 0; block < blocks; block++) {
+        const size_t begin = size_t(block * blockSize), end = std::min<size_t>(count, begin + blockSize);
+        int index[blockSize];
+        #pragma omp simd
+        for (size_t i = begin; i < end; i++)
+            index[i - begin] = lutIndex(iterations[i]);
+
+        for (size_t i = begin; i < end; i++) {
+            const sf::Color c = lut_[index[i - begin]];
+            uint8_t* p = pixels + i * channels;
+            p[0] = c.r;
+            p[1] = c.g;
+            p[2] = c.b;
+            if (channels == 4)
+                p[3] = 255;
+        }
+    }
+
+    if (!supersamples)
+        return;
+
+    const int n = supersamples->perPixel;
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < (long long)supersamples->pixels.size(); i++) {
+        uint8_t* p = pixels + supersamples->pixels[i] * channels;
+        int r = p[0], g = p[1], b = p[2];
+        for (int s = 0; s < n; s++) {
+            const sf::Color c = lut_[lutIndex(supersamples->samples[i * n + s])];
+            r += c.r;
+            g += c.g;
+            b += c.b;
+        }
+        p[0] = uint8_t((r + n / 2) / (n + 1));
+        p[1] = uint8_t((g + n / 2) / (n + 1));
+        p[2] = uint8_t((b + n / 2) / (n + 1));
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "antialias.hpp"
+
+//colors the continuous escape counts of the renderers, as a pass of its own so that
+//changing the palette doesnt need the orbits again
+//a count goes through a tone curve to [0, 1], which picks the color along the palette gradient
+//bounded points get the inside color, the disc around the origin is marked red
+class Colorizer {
+public:
+    enum class Palette { Ice, Fire, Gray };
+
+    //the tone curve starts as a power curve that spreads the low counts
+    Colorizer(size_t maxIter, Palette palette = Palette::Ice);
+
+    //palette by name, false if there is none
+    static bool parsePalette(const std::string& name, Palette& palette);
+
+    //tone curve from the histogram of the escaped counts, every color then covers about as many pixels
+    void equalize(const float* iterations, size_t count);
+    //channels is 3 for rgb output, 4 for rgba
+    //supersampled pixels get the average color of all their samples
+    void apply(const float* iterations, size_t count, uint8_t* pixels, int channels, 
+        const Supersamples* supersamples = nullptr) const;
+    sf::Color getColor(float iterations) const { return lut_[lutIndex(iterations)]; }
+
+private:
+    //position in lut_, the gradient then the inside and disc colors
+    int lutIndex(float iterations) const {
+        if (iterations < 0.f)
+            return gradientSize + 1;
+        if (iterations >= maxCount_)
+            return gradientSize;
+        int bin = int(iterations);
+        float t = tone_[bin] + (tone_[bin + 1] - tone_[bin]) * (iterations - bin);
+        return int(t * (gradientSize - 1));
+    }
+
+    //value at every integer count, interpolated in between, maxIter + 1 entries
+    std::vector<float> tone_;
+    std::vector<sf::Color> lut_;
+    const float maxCount_;
+
+    static constexpr int gradientSize = 1024;
+    //exponent of the starting tone curve
+    static constexpr double toneExponent = 1 - 0.7;
+};
@@ -0,0 +1,432 @@
+#include "distributed.hpp"
+#include "scheduler.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace {
+    //first field of every packet
+    enum class Message : std::uint8_t {
+        //worker: signature
+        Hello,
+        //coordinator: id, x0, y0, width, height
+        Job,
+        //worker: id, counts row by row, samples per pixel, refined pixels, their indices and samples
+        Result,
+        //coordinator: no more jobs, or a worker with the wrong signature
+        Done
+    };
+
+    sf::Packet& operator<<(sf::Packet& packet, Message message) {
+        return packet << std::uint8_t(message);
+    }
+
+    sf::Packet& operator>>(sf::Packet& packet, Message& message) {
+        std::uint8_t value = 0;
+        packet >> value;
+        message = Message(value);
+        return packet;
+    }
+
+    //the coordinator only sends a few bytes at a time, a partial send just continues the same packet
+    bool sendPacket(sf::TcpSocket& socket, sf::Packet& packet) {
+        sf::Socket::Status status;
+        while ((status = socket.send(packet)) == sf::Socket::Status::Partial)
+            ;
+        return status == sf::Socket::Status::Done;
+    }
+}
+
+RenderCoordinator::RenderCoordinator(unsigned short port, sf::Vector2u imageSize, int aaSamples, const std::string& signature)
+    :
+    port_(port),
+    signature_(signature),
+    imageSize_(imageSize),
+    aaSamples_(aaSamples)
+{
+    listening_ = listener_.listen(port) == sf::Socket::Status::Done;
+    if (listening_)
+        selector_.add(listener_);
+}
+
+bool RenderCoordinator::run(StreamingImageWriter& writer, const Colorizer& colorizer, ProgressReporter& progress)
+{
+    firstRow_ = writer.getRowsWritten();
+    bandHeight_ = writer.getBandHeight();
+    bandCount_ = (imageSize_.y - firstRow_ + bandHeight_ - 1) / bandHeight_;
+    jobsPerBand_ = (imageSize_.x + jobWidth - 1) / jobWidth;
+
+    jobs_.resize(bandCount_ * jobsPerBand_);
+    for (size_t b = 0; b < bandCount_; b++) {
+        const unsigned y0 = firstRow_ + unsigned(b) * bandHeight_;
+        for (size_t c = 0; c < jobsPerBand_; c++) {
+            Job& job = jobs_[b * jobsPerBand_ + c];
+            job.x0 = unsigned(c) * jobWidth;
+            job.y0 = y0;
+            job.width = std::min(jobWidth, imageSize_.x - job.x0);
+            job.height = std::min(bandHeight_, imageSize_.y - y0);
+        }
+    }
+    openBands();
+    std::cout << "waiting for workers on port " << port_ << "\n";
+
+    while (writtenBands_ < bandCount_) {
+        if (!selector_.wait(sf::seconds(1)))
+            continue;
+        if (selector_.isReady(listener_))
+            acceptPeer();
+
+        for (size_t i = 0; i < peers_.size(); i++) {
+            if (selector_.isReady(*peers_[i]->socket) && !receive(*peers_[i], progress))
+                dropPeer(i--);
+        }
+        if (!writeBands(writer, colorizer))
+            return false;
+        for (auto& peer : peers_)
+            dispatch(*peer);
+    }
+
+    sf::Packet done;
+    done << Message::Done;
+    for (auto& peer : peers_)
+        sendPacket(*peer->socket, done);
+    return true;
+}
+
+void RenderCoordinator::acceptPeer()
+{
+    auto peer = std::make_unique<Peer>();
+    if (listener_.accept(*peer->socket) != sf::Socket::Status::Done)
+        return;
+    //a worker that stalls in the middle of a packet mustnt block the others
+    peer->socket->setBlocking(false);
+    selector_.add(*peer->socket);
+    peers_.push_back(std::move(peer));
+}
+
+bool RenderCoordinator::receive(Peer& peer, ProgressReporter& progress)
+{
+    //the socket keeps the part of a packet received so far until the rest comes in
+    sf::Packet packet;
+    const sf::Socket::Status status = peer.socket->receive(packet);
+    if (status == sf::Socket::Status::NotReady || status == sf::Socket::Status::Partial)
+        return true;
+    if (status != sf::Socket::Status::Done)
+        return false;
+
+    Message message;
+    packet >> message;
+    if (message == Message::Hello) {
+        std::string signature;
+        packet >> signature;
+        peer.accepted = signature == signature_;
+        if (!peer.accepted) {
+            std::cout << "a worker with other settings was turned away\n";
+            sf::Packet done;
+            done << Message::Done;
+            sendPacket(*peer.socket, done);
+        }
+        return peer.accepted;
+    }
+    if (message != Message::Result || !peer.accepted)
+        return false;
+
+    std::uint64_t id = 0;
+    packet >> id;
+    auto held = std::find(peer.jobs.begin(), peer.jobs.end(), size_t(id));
+    if (held == peer.jobs.end())
+        return false;
+
+    //the sizes come from the network, they are checked before anything is allocated from them
+    //a bad result drops the peer while it still holds the job, which puts the job back in the queue
+    PROFILE_SCOPE("RenderCoordinator::receive");
+    Job& job = jobs_[id];
+    std::vector<float> iterations(size_t(job.width) * job.height);
+    for (auto& n : iterations)
+        packet >> n;
+    std::int32_t perPixel = 0;
+    std::uint64_t refined = 0;
+    packet >> perPixel >> refined;
+    if (!packet || refined > iterations.size() || (refined > 0 && perPixel != aaSamples_))
+        return false;
+    std::vector<std::uint32_t> pixels(refined);
+    std::vector<float> samples(refined * perPixel);
+    for (auto& p : pixels) {
+        packet >> p;
+        if (p >= iterations.size())
+            return false;
+    }
+    for (auto& s : samples)
+        packet >> s;
+    if (!packet)
+        return false;
+
+    peer.jobs.erase(held);
+    job.copies--;
+    //the other copy of a straggler came back first
+    if (job.done)
+        return true;
+
+    Band& target = bands_[id / jobsPerBand_ - writtenBands_];
+    //the job's rows go into the band, its pixel indices become indices in the band
+    for (unsigned y = 0; y < job.height; y++)
+        std::copy_n(&iterations[size_t(y) * job.width], job.width, &target.iterations[size_t(y) * imageSize_.x + job.x0]);
+    target.supersamples.perPixel = perPixel;
+    for (auto p : pixels)
+        target.supersamples.pixels.push_back(size_t(p / job.width) * imageSize_.x + job.x0 + p % job.width);
+    target.supersamples.samples.insert(target.supersamples.samples.end(), samples.begin(), samples.end());
+
+    job.done = true;
+    target.jobsLeft--;
+    progress.add(iterations.size());
+    return true;
+}
+
+void RenderCoordinator::dropPeer(size_t index)
+{
+    Peer& peer = *peers_[index];
+    //a job nobody else holds goes back to the front of the queue, it is one of the oldest
+    for (auto id : peer.jobs) {
+        if (--jobs_[id].copies == 0 && !jobs_[id].done)
+            queue_.push_front(id);
+    }
+    if (peer.accepted && writtenBands_ < bandCount_)
+        std::cout << "lost a worker, " << peer.jobs.size() << " jobs handed out again\n";
+    selector_.remove(*peer.socket);
+    peers_.erase(peers_.begin() + index);
+}
+
+void RenderCoordinator::dispatch(Peer& peer)
+{
+    while (peer.accepted && peer.jobs.size() < jobsPerPeer) {
+        size_t id;
+        if (!queue_.empty()) {
+            id = queue_.front();
+            queue_.pop_front();
+        }
+        //only an idle worker takes over someone else's job, a busy one will ask again soon enough
+        else if (!peer.jobs.empty() || !findStraggler(peer, id))
+            return;
+
+        //a copy keeps the time of the first one, so that it isnt copied again right away
+        Job& job = jobs_[id];
+        if (job.copies++ == 0)
+            job.sent = std::chrono::steady_clock::now();
+        peer.jobs.push_back(id);
+
+        //after a failed send the job stays with the worker until it disconnects or an idle one copies it
+        sf::Packet packet;
+        packet << Message::Job << std::uint64_t(id) << job.x0 << job.y0 << job.width << job.height;
+        if (!sendPacket(*peer.socket, packet))
+            return;
+    }
+}
+
+bool RenderCoordinator::findStraggler(const Peer& peer, size_t& id) const
+{
+    bool found = false;
+    const size_t end = openedBands_ * jobsPerBand_;
+    for (size_t i = writtenBands_ * jobsPerBand_; i < end; i++) {
+        const Job& job = jobs_[i];
+        if (job.done || job.copies != 1 || (found && job.sent >= jobs_[id].sent))
+            continue;
+        if (std::find(peer.jobs.begin(), peer.jobs.end(), i) == peer.jobs.end()) {
+            id = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void RenderCoordinator::openBands()
+{
+    while (openedBands_ < bandCount_ && openedBands_ < writtenBands_ + bandWindow) {
+        Band band;
+        const unsigned rows = jobs_[openedBands_ * jobsPerBand_].height;
+        band.iterations.resize(size_t(imageSize_.x) * rows);
+        band.jobsLeft = jobsPerBand_;
+        bands_.push_back(std::move(band));
+        for (size_t c = 0; c < jobsPerBand_; c++)
+            queue_.push_back(openedBands_ * jobsPerBand_ + c);
+        openedBands_++;
+    }
+}
+
+bool RenderCoordinator::writeBands(StreamingImageWriter& writer, const Colorizer& colorizer)
+{
+    std::vector<uint8_t> rgb;
+    while (!bands_.empty() && bands_.front().jobsLeft == 0) {
+        const Band& band = bands_.front();
+        rgb.resize(band.iterations.size() * 3);
+        colorizer.apply(band.iterations.data(), band.iterations.size(), rgb.data(), 3, &band.supersamples);
+        if (!writer.writeRows(rgb.data(), unsigned(band.iterations.size() / imageSize_.x)))
+            return false;
+
+        bands_.pop_front();
+        writtenBands_++;
+        openBands();
+    }
+    return true;
+}
+
+RenderWorker::RenderWorker(const std::string& host, unsigned short port, const std::string& signature)
+    :
+    signature_(signature)
+{
+    auto address = sf::IpAddress::resolve(host);
+    connected_ = address && socket_.connect(*address, port, sf::seconds(10)) == sf::Socket::Status::Done;
+}
+
+bool RenderWorker::run(const TileRenderer::PixelKernel& kernel, size_t maxIter, int aaSamples)
+{
+    sf::Packet hello;
+    hello << Message::Hello << signature_;
+    if (socket_.send(hello) != sf::Socket::Status::Done)
+        return false;
+
+    WorkStealingPool pool;
+    size_t jobs = 0;
+    while (true) {
+        sf::Packet packet;
+        if (socket_.receive(packet) != sf::Socket::Status::Done)
+            return false;
+        Message message;
+        packet >> message;
+        if (message != Message::Job) {
+            std::cout << "rendered " << jobs << " jobs\n";
+            return jobs > 0;
+        }
+
+        std::uint64_t id = 0;
+        unsigned x0 = 0, y0 = 0, width = 0, height = 0;
+        packet >> id >> x0 >> y0 >> width >> height;
+
+        //the renderer sees the job as a whole image
+        TileRenderer::PixelKernel jobKernel = [&](const double* px, const double* py, size_t count, float* out) {
+            thread_local std::vector<double> sx, sy;
+            sx.resize(count);
+            sy.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                sx[i] = px[i] + x0;
+                sy[i] = py[i] + y0;
+            }
+            kernel(sx.data(), sy.data(), count, out);
+            };
+        TileRenderer renderer(width, height, jobKernel);
+        auto iterations = renderer.render(pool);
+        //like the bands, edges across jobs are missed
+        Supersamples supersamples;
+        if (aaSamples > 0)
+            supersamples = EdgeSupersampler(width, height, maxIter, aaSamples).refine(iterations.data(), jobKernel);
+
+        sf::Packet result;
+        result << Message::Result << id;
+        for (auto n : iterations)
+            result << n;
+        result << std::int32_t(supersamples.perPixel) << std::uint64_t(supersamples.pixels.size());
+        for (auto p : supersamples.pixels)
+            result << std::uint32_t(p);
+        for (auto s : supersamples.samples)
+            result << s;
+        if (socket_.send(result) != sf::Socket::Status::Done)
+            return false;
+        jobs++;
+    }
+}
+
+#if defined(_WIN32)
+//quoted the way the c runtime splits the command line again, backslashes only escape quotes and each other
+static std::string quoteArgument(const std::string& arg)
+{
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : arg) {
+        if (c == '\\') {
+            backslashes++;
+            continue;
+        }
+        quoted.append(c == '"' ? 2 * backslashes + 1 : backslashes, '\\');
+        backslashes = 0;
+        quoted += c;
+    }
+    quoted.append(2 * backslashes, '\\');
+    return quoted + "\"";
+}
+#endif
+
+LocalWorkers::LocalWorkers(const std::string& program, const std::vector<std::string>& args, int count)
+{
+#if defined(_WIN32)
+    std::string commandLine = quoteArgument(program);
+    for (const auto& arg : args)
+        commandLine += " " + quoteArgument(arg);
+
+    for (int i = 0; i < count; i++) {
+        STARTUPINFOA startup = { sizeof(startup) };
+        PROCESS_INFORMATION info = {};
+        std::vector<char> buffer(commandLine.begin(), commandLine.end());
+        buffer.push_back('\0');
+        if (!CreateProcessA(nullptr, buffer.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &info)) {
+            std::cout << "cannot start a worker\n";
+            continue;
+        }
+        CloseHandle(info.hThread);
+        processes_.push_back(info.hProcess);
+    }
+#else
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for (const auto& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    for (int i = 0; i < count; i++) {
+        pid_t pid;
+        if (posix_spawnp(&pid, program.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+            std::cout << "cannot start a worker\n";
+            continue;
+        }
+        processes_.push_back(pid);
+    }
+#endif
+}
+
+LocalWorkers::~LocalWorkers()
+{
+    const auto deadline = std::chrono::steady_clock::now() + exitTimeout;
+#if defined(_WIN32)
+    for (void* process : processes_) {
+        auto left = std::max(std::chrono::milliseconds(0),
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()));
+        if (WaitForSingleObject(process, DWORD(left.count())) != WAIT_OBJECT_0) {
+            TerminateProcess(process, 1);
+            WaitForSingleObject(process, INFINITE);
+        }
+        CloseHandle(process);
+    }
+#else
+    for (long pid : processes_) {
+        while (waitpid(pid_t(pid), nullptr, WNOHANG) == 0) {
+            if (std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                continue;
+            }
+            kill(pid_t(pid), SIGKILL);
+            waitpid(pid_t(pid), nullptr, 0);
+            break;
+        }
+    }
+#endif
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tiles.hpp"
+#include "antialias.hpp"
+#include "coloring.hpp"
+#include "imagewriter.hpp"
+#include "progress.hpp"
+
+//a streamed render split across worker processes, on this machine or others, talking over tcp
+//the coordinator cuts the bands of the writer into jobs and writes a band as soon as all its jobs are back,
+//only a few bands past the one being written are handed out so that memory stays bounded
+//jobs of a worker that disconnects go back to the queue, and once the queue is empty an idle worker
+//gets a copy of the oldest job still out, whichever copy comes back first is kept
+class RenderCoordinator {
+public:
+    //signature identifies the render, workers started with another one are turned away
+    //aaSamples is what the workers have to send for every refined pixel
+    RenderCoordinator(unsigned short port, sf::Vector2u imageSize, int aaSamples, const std::string& signature);
+    bool isListening() const { return listening_; }
+
+    //renders the rows the writer doesnt have yet, colored by colorizer
+    bool run(StreamingImageWriter& writer, const Colorizer& colorizer, ProgressReporter& progress);
+
+private:
+    struct Job {
+        unsigned x0, y0, width, height;
+        //workers currently holding a copy
+        int copies = 0;
+        bool done = false;
+        std::chrono::steady_clock::time_point sent;
+    };
+    struct Peer {
+        std::unique_ptr<sf::TcpSocket> socket = std::make_unique<sf::TcpSocket>();
+        //set once the signature matched
+        bool accepted = false;
+        std::vector<size_t> jobs;
+    };
+    struct Band {
+        std::vector<float> iterations;
+        Supersamples supersamples;
+        size_t jobsLeft;
+    };
+
+    void acceptPeer();
+    //false if the peer has to be dropped
+    bool receive(Peer& peer, ProgressReporter& progress);
+    void dropPeer(size_t index);
+    void dispatch(Peer& peer);
+    //oldest job out with a single copy, that peer doesnt hold already
+    bool findStraggler(const Peer& peer, size_t& id) const;
+    //queues the jobs of the bands that fit in the window
+    void openBands();
+    bool writeBands(StreamingImageWriter& writer, const Colorizer& colorizer);
+
+    sf::TcpListener listener_;
+    sf::SocketSelector selector_;
+    bool listening_ = false;
+    unsigned short port_;
+    std::string signature_;
+    sf::Vector2u imageSize_;
+    int aaSamples_;
+
+    std::vector<std::unique_ptr<Peer>> peers_;
+    //all the jobs from the first band on, band by band
+    std::vector<Job> jobs_;
+    std::deque<size_t> queue_;
+    //bands from the next one to write on
+    std::deque<Band> bands_;
+    unsigned firstRow_ = 0;
+    unsigned bandHeight_ = 0;
+    size_t bandCount_ = 0;
+    size_t jobsPerBand_ = 0;
+    size_t writtenBands_ = 0;
+    size_t openedBands_ = 0;
+
+    static constexpr unsigned jobWidth = 1024;
+    //bands handed out past the one being written
+    static constexpr size_t bandWindow = 4;
+    //jobs a worker gets ahead, so that it doesnt wait for the next one
+    static constexpr size_t jobsPerPeer = 2;
+};
+
+//renders the jobs of a coordinator until it is done or gone
+class RenderWorker {
+public:
+    RenderWorker(const std::string& host, unsigned short port, const std::string& signature);
+    bool isConnected() const { return connected_; }
+    //kernel and maxIter have to be those of the coordinator's render, the signature makes sure of it
+    bool run(const TileRenderer::PixelKernel& kernel, size_t maxIter, int aaSamples);
+
+private:
+    sf::TcpSocket socket_;
+    std::string signature_;
+    bool connected_ = false;
+};
+
+//worker processes started on this machine, run directly without a shell so that the arguments reach them as they are
+//the destructor waits for them, the ones still running a few seconds after the coordinator is done are killed
+class LocalWorkers {
+public:
+    LocalWorkers(const std::string& program, const std::vector<std::string>& args, int count);
+    ~LocalWorkers();
+    LocalWorkers(const LocalWorkers&) = delete;
+    LocalWorkers& operator=(const LocalWorkers&) = delete;
+    size_t getCount() const { return processes_.size(); }
+
+private:
+    //process handles on windows, pids elsewhere
+#if defined(_WIN32)
+    std::vector<void*> processes_;
+#else
+    std::vector<long> processes_;
+#endif
+    static constexpr auto exitTimeout = std::chrono::seconds(5);
+};
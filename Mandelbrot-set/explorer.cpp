@@ -0,0 +1,368 @@
+#include "explorer.hpp"
+#include "kernel.hpp"
+#include "profiler.hpp"
+#include <cmath>
+#include <algorithm>
+#include <string>
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+Explorer::Explorer(sf::Vector2u windowSize, size_t maxIter, const Colorizer& colorizer, const Formula& formula)
+    :
+    maxIter_(maxIter),
+    formula_(formula)
+{
+    window_.create(sf::VideoMode(windowSize), "Mandelbrot-set");
+    window_.setFramerateLimit(60);
+    window_.setKeyRepeatEnabled(false);
+
+    for (size_t n = 0; n <= maxIter; n++)
+        palette_.push_back(colorizer.getColor(float(n)));
+    discColor_ = colorizer.getColor(-1.f);
+
+    //same view as the batch render
+    double centerRe, centerIm;
+    formula.getDefaultCenter(centerRe, centerIm);
+    View view;
+    view.size = windowSize;
+    view.originX = int64_t(std::floor(centerRe / pixelSize(0))) - windowSize.x / 2;
+    view.originY = int64_t(std::floor(-centerIm / pixelSize(0))) - windowSize.y / 2;
+    view_ = view;
+
+    renderThread_ = std::thread(&Explorer::renderLoop, this);
+}
+
+Explorer::~Explorer()
+{
+    //changed under the lock, so that the render thread cant miss it between its check and its wait
+    {
+        std::lock_guard lock(viewMutex_);
+        stopping_ = true;
+        generation_++;
+    }
+    viewChanged_.notify_all();
+    renderThread_.join();
+}
+
+double Explorer::pixelSize(int zoom)
+{
+    //powers of 2, so that pixel 2x of a level is exactly pixel x of the level above
+    return std::ldexp(1.0 / 256, -zoom);
+}
+
+void Explorer::run()
+{
+    unsigned long long composedGeneration = ~0ull;
+    while (window_.isOpen()) {
+        handleEvents();
+
+        if (tilesChanged_.exchange(false) || composedGeneration != generation_) {
+            composedGeneration = generation_;
+            compose();
+        }
+
+        window_.clear();
+        sf::Sprite sprite(texture_);
+        window_.draw(sprite);
+        window_.display();
+    }
+}
+
+void Explorer::handleEvents()
+{
+    View view;
+    {
+        std::lock_guard lock(viewMutex_);
+        view = view_;
+    }
+    bool changed = false;
+
+    while (const std::optional event = window_.pollEvent()) {
+        if (event->is<sf::Event::Closed>())
+            window_.close();
+        else if (const auto* r = event->getIf<sf::Event::Resized>()) {
+            window_.setView(sf::View(sf::FloatRect({ 0.f, 0.f }, sf::Vector2f(r->size))));
+            view.size = r->size;
+            changed = true;
+        }
+        else if (const auto* w = event->getIf<sf::Event::MouseWheelScrolled>()) {
+            //zoom around the cursor, the pixel under it stays in place
+            const sf::Vector2i p = w->position;
+            if (w->delta > 0 && view.zoom < maxZoom) {
+                view.zoom++;
+                view.originX = 2 * (view.originX + p.x) - p.x;
+                view.originY = 2 * (view.originY + p.y) - p.y;
+                changed = true;
+            }
+            else if (w->delta < 0 && view.zoom > 0) {
+                view.zoom--;
+                view.originX = floorDiv(view.originX + p.x, 2) - p.x;
+                view.originY = floorDiv(view.originY + p.y, 2) - p.y;
+                changed = true;
+            }
+        }
+        else if (const auto* b = event->getIf<sf::Event::MouseButtonPressed>()) {
+            if (b->button == sf::Mouse::Button::Left) {
+                isDragging_ = true;
+                dragStart_ = b->position;
+            }
+        }
+        else if (const auto* b = event->getIf<sf::Event::MouseButtonReleased>()) {
+            if (b->button == sf::Mouse::Button::Left)
+                isDragging_ = false;
+        }
+        else if (const auto* m = event->getIf<sf::Event::MouseMoved>()) {
+            if (isDragging_) {
+                view.originX -= m->position.x - dragStart_.x;
+                view.originY -= m->position.y - dragStart_.y;
+                dragStart_ = m->position;
+                changed = true;
+            }
+        }
+        else if (const auto* k = event->getIf<sf::Event::KeyPressed>()) {
+            if (k->code == sf::Keyboard::Key::Escape)
+                window_.close();
+        }
+    }
+
+    if (changed)
+        setView(view);
+}
+
+void Explorer::setView(const View& view)
+{
+    //work for the old view stops at its next check
+    {
+        std::lock_guard lock(viewMutex_);
+        view_ = view;
+        generation_++;
+    }
+    viewChanged_.notify_all();
+
+    double ps = pixelSize(view.zoom);
+    double cr = (view.originX + view.size.x / 2.0) * ps, ci = -(view.originY + view.size.y / 2.0) * ps;
+    window_.setTitle("Mandelbrot-set  " + std::to_string(cr) + (ci < 0 ? " - " : " + ") + 
+        std::to_string(std::abs(ci)) + "i  zoom 2^" + std::to_string(view.zoom));
+}
+
+std::vector<Explorer::TileKey> Explorer::visibleTiles(const View& view) const
+{
+    std::vector<TileKey> keys;
+    int64_t x0 = floorDiv(view.originX, tileSize), x1 = floorDiv(view.originX + view.size.x - 1, tileSize);
+    int64_t y0 = floorDiv(view.originY, tileSize), y1 = floorDiv(view.originY + view.size.y - 1, tileSize);
+    for (int64_t y = y0; y <= y1; y++)
+        for (int64_t x = x0; x <= x1; x++)
+            keys.push_back({ view.zoom, x, y });
+
+    //the middle of the window is where the user looks
+    double mx = (view.originX + view.size.x / 2.0) / tileSize - 0.5, my = (view.originY + view.size.y / 2.0) / tileSize - 0.5;
+    std::sort(keys.begin(), keys.end(), [&](const TileKey& a, const TileKey& b) {
+        return std::hypot(a.x - mx, a.y - my) < std::hypot(b.x - mx, b.y - my);
+        });
+    return keys;
+}
+
+void Explorer::renderLoop()
+{
+    while (!stopping_) {
+        View view;
+        unsigned long long generation;
+        {
+            std::lock_guard lock(viewMutex_);
+            view = view_;
+            generation = generation_;
+        }
+
+        auto keys = visibleTiles(view);
+        std::vector<std::shared_ptr<Tile>> tiles;
+        for (const auto& key : keys)
+            tiles.push_back(getTile(key));
+        evictTiles(keys);
+
+        //every visible tile gets a pass before any gets the next one
+        for (int step : passSteps) {
+            #pragma omp parallel for schedule(dynamic)
+            for (int t = 0; t < int(tiles.size()); t++) {
+                if (generation_ != generation || (tiles[t]->step != 0 && tiles[t]->step <= step))
+                    continue;
+                if (renderPass(*tiles[t], keys[t], step, generation))
+                    tilesChanged_ = true;
+            }
+            if (generation_ != generation)
+                break;
+        }
+
+        //nothing left to do until the view changes
+        std::unique_lock lock(viewMutex_);
+        viewChanged_.wait(lock, [&] { return generation_ != generation || stopping_; });
+    }
+}
+
+std::shared_ptr<Explorer::Tile> Explorer::getTile(const TileKey& key)
+{
+    {
+        std::lock_guard lock(cacheMutex_);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) {
+            it->second->lastUsed = ++useCounter_;
+            return it->second;
+        }
+    }
+
+    auto tile = std::make_shared<Tile>();
+    tile->iterations.assign(tileSize * tileSize, unknown);
+    seedTile(*tile, key);
+
+    std::lock_guard lock(cacheMutex_);
+    tile->lastUsed = ++useCounter_;
+    cache_[key] = tile;
+    return tile;
+}
+
+void Explorer::seedTile(Tile& tile, const TileKey& key)
+{
+    auto find = [&](const TileKey& k) -> std::shared_ptr<Tile> {
+        std::lock_guard lock(cacheMutex_);
+        auto it = cache_.find(k);
+        return it == cache_.end() ? nullptr : it->second;
+        };
+
+    //pixel (2x, 2y) of this level is pixel (x, y) of the level above
+    if (auto parent = find({ key.zoom - 1, floorDiv(key.x, 2), floorDiv(key.y, 2) })) {
+        std::lock_guard lock(parent->mutex);
+        int64_t px0 = floorDiv(key.x, 2) * tileSize, py0 = floorDiv(key.y, 2) * tileSize;
+        for (int ly = 0; ly < tileSize; ly += 2) {
+            for (int lx = 0; lx < tileSize; lx += 2) {
+                int64_t gx = key.x * tileSize + lx, gy = key.y * tileSize + ly;
+                tile.iterations[ly * tileSize + lx] = parent->iterations[(gy / 2 - py0) * tileSize + (gx / 2 - px0)];
+            }
+        }
+    }
+
+    //and pixel (x, y) of this level is pixel (2x, 2y) of the level below
+    for (int c = 0; c < 4; c++) {
+        TileKey childKey{ key.zoom + 1, 2 * key.x + (c & 1), 2 * key.y + (c >> 1) };
+        auto child = find(childKey);
+        if (!child)
+            continue;
+
+        std::lock_guard lock(child->mutex);
+        const int ox = (c & 1) * tileSize / 2, oy = (c >> 1) * tileSize / 2;
+        for (int ly = 0; ly < tileSize / 2; ly++) {
+            for (int lx = 0; lx < tileSize / 2; lx++) {
+                uint32_t n = child->iterations[(2 * ly) * tileSize + 2 * lx];
+                if (n != unknown)
+                    tile.iterations[(oy + ly) * tileSize + ox + lx] = n;
+            }
+        }
+    }
+}
+
+void Explorer::evictTiles(const std::vector<TileKey>& visible)
+{
+    std::lock_guard lock(cacheMutex_);
+    if (cache_.size() <= maxCachedTiles)
+        return;
+
+    //least recently used first, the visible ones were just used
+    std::vector<std::pair<unsigned long long, TileKey>> byUse;
+    for (const auto& [key, tile] : cache_)
+        byUse.emplace_back(tile->lastUsed, key);
+    std::sort(byUse.begin(), byUse.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    size_t excess = cache_.size() - maxCachedTiles;
+    for (size_t i = 0; i < excess && i + visible.size() < byUse.size(); i++)
+        cache_.erase(byUse[i].second);
+}
+
+bool Explorer::renderPass(Tile& tile, const TileKey& key, int step, unsigned long long generation)
+{
+    PROFILE_SCOPE("Explorer::renderPass");
+    //small batches so that a view change is noticed quickly
+    constexpr size_t batchSize = 2048;
+    const double ps = pixelSize(key.zoom);
+
+    std::vector<int> indices;
+    for (int ly = 0; ly < tileSize; ly += step)
+        for (int lx = 0; lx < tileSize; lx += step)
+            if (tile.iterations[ly * tileSize + lx] == unknown)
+                indices.push_back(ly * tileSize + lx);
+
+    std::vector<double> cr, ci;
+    std::vector<size_t> out;
+    for (size_t begin = 0; begin < indices.size(); begin += batchSize) {
+        if (generation_ != generation)
+            return false;
+
+        size_t count = std::min(batchSize, indices.size() - begin);
+        cr.resize(count);
+        ci.resize(count);
+        out.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            int index = indices[begin + i];
+            //screen y grows downwards, the imaginary axis upwards
+            cr[i] = (key.x * tileSize + index % tileSize) * ps;
+            ci[i] = -(key.y * tileSize + index / tileSize) * ps;
+        }
+        iterateBatch(cr.data(), ci.data(), count, maxIter_, out.data(), nullptr, formula_);
+
+        std::lock_guard lock(tile.mutex);
+        for (size_t i = 0; i < count; i++)
+            tile.iterations[indices[begin + i]] = out[i] == size_t(-1) ? disc : uint32_t(out[i]);
+    }
+
+    tile.step = step;
+    return true;
+}
+
+void Explorer::compose()
+{
+    PROFILE_SCOPE("Explorer::compose");
+    View view;
+    {
+        std::lock_guard lock(viewMutex_);
+        view = view_;
+    }
+    if (texture_.getSize() != view.size && !texture_.resize(view.size))
+        return;
+    pixels_.assign(size_t(view.size.x) * view.size.y * 4, 0);
+
+    for (const auto& key : visibleTiles(view)) {
+        std::shared_ptr<Tile> tile;
+        {
+            std::lock_guard lock(cacheMutex_);
+            auto it = cache_.find(key);
+            if (it == cache_.end())
+                continue;
+            tile = it->second;
+        }
+
+        std::lock_guard lock(tile->mutex);
+        const int64_t tx = key.x * tileSize - view.originX, ty = key.y * tileSize - view.originY;
+        const int x0 = int(std::max<int64_t>(0, tx)), x1 = int(std::min<int64_t>(view.size.x, tx + tileSize));
+        const int y0 = int(std::max<int64_t>(0, ty)), y1 = int(std::min<int64_t>(view.size.y, ty + tileSize));
+
+        for (int sy = y0; sy < y1; sy++) {
+            for (int sx = x0; sx < x1; sx++) {
+                int lx = int(sx - tx), ly = int(sy - ty);
+                //the sample of the finest pass that covers the pixel
+                uint32_t n = unknown;
+                for (int s = 1; s <= passSteps[0] && n == unknown; s *= 2)
+                    n = tile->iterations[(ly & ~(s - 1)) * tileSize + (lx & ~(s - 1))];
+                if (n == unknown)
+                    continue;
+
+                sf::Color c = n == disc ? discColor_ : palette_[std::min<size_t>(n, maxIter_)];
+                uint8_t* p = &pixels_[(size_t(sy) * view.size.x + sx) * 4];
+                p[0] = c.r;
+                p[1] = c.g;
+                p[2] = c.b;
+                p[3] = 255;
+            }
+        }
+    }
+
+    texture_.update(pixels_.data());
+}
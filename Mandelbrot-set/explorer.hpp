@@ -0,0 +1,105 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "coloring.hpp"
+#include "formulas.hpp"
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+//interactive viewer, the view is rendered in the background in passes of finer and finer samples
+//iterations are cached in tiles keyed by (zoom, tile), so panning only computes the newly exposed tiles,
+//and a new tile starts from the samples its parent or children already have, since the pixel grids of
+//neighbouring zoom levels share every other sample
+//changing the view bumps a generation counter, the background work for older generations stops
+class Explorer {
+public:
+    Explorer(sf::Vector2u windowSize, size_t maxIter, const Colorizer& colorizer, const Formula& formula = Formula());
+    ~Explorer();
+
+    //until the window is closed
+    void run();
+
+private:
+    struct TileKey {
+        int zoom;
+        int64_t x, y;
+        bool operator==(const TileKey&) const = default;
+    };
+    struct TileKeyHash {
+        size_t operator()(const TileKey& k) const {
+            return std::hash<int64_t>()(k.x * 0x9E3779B97F4A7C15ll ^ k.y * 0xC2B2AE3D27D4EB4Fll ^ k.zoom);
+        }
+    };
+    struct Tile {
+        //guards iterations against the display reading them while a pass writes
+        std::mutex mutex;
+        //row by row, unknown where not computed yet
+        std::vector<uint32_t> iterations;
+        //sample spacing of the last completed pass, 0 before the first one
+        int step = 0;
+        unsigned long long lastUsed = 0;
+    };
+    //top left pixel of the window on the pixel grid of the zoom level, the grid is aligned on 0
+    struct View {
+        int zoom = 0;
+        int64_t originX = 0, originY = 0;
+        sf::Vector2u size;
+    };
+
+    void renderLoop();
+    //computes the samples spaced by step that arent known yet, false if the view changed meanwhile
+    bool renderPass(Tile& tile, const TileKey& key, int step, unsigned long long generation);
+    std::shared_ptr<Tile> getTile(const TileKey& key);
+    //copies the samples the cached parent and children of the tile share with it
+    void seedTile(Tile& tile, const TileKey& key);
+    //visible tiles, the ones closest to the middle of the window first
+    std::vector<TileKey> visibleTiles(const View& view) const;
+    void evictTiles(const std::vector<TileKey>& visible);
+
+    void handleEvents();
+    void setView(const View& view);
+    //draws the cached samples, unknown pixels take the closest coarser sample
+    void compose();
+    static double pixelSize(int zoom);
+
+    sf::RenderWindow window_;
+    sf::Texture texture_;
+    std::vector<uint8_t> pixels_;
+    //color of every iteration count, and of the disc
+    std::vector<sf::Color> palette_;
+    sf::Color discColor_;
+
+    std::mutex viewMutex_;
+    std::condition_variable viewChanged_;
+    View view_;
+    std::atomic<unsigned long long> generation_ = 0;
+    //set by the passes, the window is composed again when it is
+    std::atomic<bool> tilesChanged_ = true;
+
+    std::mutex cacheMutex_;
+    std::unordered_map<TileKey, std::shared_ptr<Tile>, TileKeyHash> cache_;
+    unsigned long long useCounter_ = 0;
+
+    std::thread renderThread_;
+    std::atomic<bool> stopping_ = false;
+    sf::Vector2i dragStart_;
+    bool isDragging_ = false;
+
+    static constexpr int tileSize = 128;
+    //spacing of the samples of the successive passes
+    static constexpr int passSteps[4] = { 8, 4, 2, 1 };
+    static constexpr size_t maxCachedTiles = 2048;
+    //pixels of 2^-48, a few bits above the precision of doubles around |c| = 1
+    static constexpr int maxZoom = 40;
+    static constexpr uint32_t unknown = uint32_t(-1);
+    //the small disc around the origin, where diverges returns size_t(-1)
+    static constexpr uint32_t disc = uint32_t(-2);
+
+    const size_t maxIter_;
+    const Formula formula_;
+};
@@ -0,0 +1,33 @@
+#include "formulas.hpp"
+#include <cmath>
+#include <algorithm>
+
+bool Formula::parse(const std::string& name, Type& type)
+{
+    if (name == "mandelbrot")
+        type = Type::Mandelbrot;
+    else if (name == "julia")
+        type = Type::Julia;
+    else if (name == "multibrot")
+        type = Type::Multibrot;
+    else if (name == "ship")
+        type = Type::BurningShip;
+    else if (name == "newton")
+        type = Type::Newton;
+    else
+        return false;
+    return true;
+}
+
+void Formula::getDefaultCenter(double& re, double& im) const
+{
+    re = type == Type::Mandelbrot || type == Type::BurningShip ? -0.5 : 0.0;
+    im = type == Type::BurningShip ? -0.5 : 0.0;
+}
+
+float formulas::Newton::smooth(const Formula&, size_t n, double move)
+{
+    //log(move) doubles every step near a root, like log|z| for the escaping formulas
+    double mu = double(n + 1) - std::log2(std::log(move) / std::log(tolerance));
+    return float(std::clamp(mu, double(n), n + 0.999));
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include "simd.hpp"
+#include "mandelbrot.hpp"
+
+//escape-time formula picked at runtime, the kernels are instantiated for every formula policy below
+struct Formula {
+    enum class Type { Mandelbrot, Julia, Multibrot, BurningShip, Newton };
+
+    Type type = Type::Mandelbrot;
+    //constant of the julia set
+    double juliaRe = -0.8, juliaIm = 0.156;
+    //power of the multibrot
+    int degree = 3;
+
+    //type by name, false if there is none
+    static bool parse(const std::string& name, Type& type);
+    //middle of the default view
+    void getDefaultCenter(double& re, double& im) const;
+    //the image is symmetric about the real axis with the default center, so half of it is enough
+    bool isMirrored() const { return type == Type::Mandelbrot || type == Type::Multibrot || type == Type::Newton; }
+};
+
+//formula policies, what the lane kernels need of a formula:
+//start: z0 and c of a point, in scalar
+//step: one iteration on every lane, returns the lanes that are done (escaped or converged)
+//finish: the value the smooth count is taken from, once a point is done, no library calls in here either
+//smooth: continuous count from the integer one and the value of finish
+//bulbChecks: the mandelbrot cardioid and bulb tests apply
+//periodicity: an orbit coming back to its checkpoint means the point never gets done
+namespace formulas {
+
+struct Mandelbrot {
+    static constexpr bool bulbChecks = true;
+    static constexpr bool periodicity = true;
+
+    static void start(const Formula&, double x, double y, double& zr, double& zi, double& cr, double& ci) {
+        zr = zi = 0.0;
+        cr = x;
+        ci = y;
+    }
+    template<typename V>
+    static unsigned step(V& zr, V& zi, V cr, V ci, const Formula&) {
+        V zr2 = zr * zr, zi2 = zi * zi;
+        zi = V::fmadd(zr + zr, zi, ci);
+        zr = (zr2 - zi2) + cr;
+        return V::greater(V::fmadd(zr, zr, zi * zi), V::set1(4.0));
+    }
+    //|z|^2 smoothExtraIterations further
+    template<typename F>
+    static double escapeMagnitude(const Formula& formula, double zr, double zi, double cr, double ci) {
+        VecD1 r{ zr }, i{ zi };
+        for (int e = 0; e < smoothExtraIterations; e++)
+            F::step(r, i, VecD1{ cr }, VecD1{ ci }, formula);
+        return r.v * r.v + i.v * i.v;
+    }
+    static double finish(const Formula& formula, double zr, double zi, double cr, double ci) {
+        return escapeMagnitude<Mandelbrot>(formula, zr, zi, cr, ci);
+    }
+    static float smooth(const Formula&, size_t n, double magnitude) {
+        return smoothIterations(n, magnitude);
+    }
+};
+
+//z0 is the point, c is fixed
+struct Julia : Mandelbrot {
+    static constexpr bool bulbChecks = false;
+
+    static void start(const Formula& formula, double x, double y, double& zr, double& zi, double& cr, double& ci) {
+        zr = x;
+        zi = y;
+        cr = formula.juliaRe;
+        ci = formula.juliaIm;
+    }
+};
+
+//z^d + c
+struct Multibrot : Mandelbrot {
+    static constexpr bool bulbChecks = false;
+
+    template<typename V>
+    static unsigned step(V& zr, V& zi, V cr, V ci, const Formula& formula) {
+        V pr = zr, pi = zi;
+        for (int k = 1; k < formula.degree; k++) {
+            V t = pr * zr - pi * zi;
+            pi = V::fmadd(pr, zi, pi * zr);
+            pr = t;
+        }
+        zr = pr + cr;
+        zi = pi + ci;
+        return V::greater(V::fmadd(zr, zr, zi * zi), V::set1(4.0));
+    }
+    static double finish(const Formula& formula, double zr, double zi, double cr, double ci) {
+        return escapeMagnitude<Multibrot>(formula, zr, zi, cr, ci);
+    }
+    static float smooth(const Formula& formula, size_t n, double magnitude) {
+        return smoothIterations(n, magnitude, formula.degree);
+    }
+};
+
+//(|re z| + i |im z|)^2 + c
+struct BurningShip : Mandelbrot {
+    static constexpr bool bulbChecks = false;
+
+    template<typename V>
+    static unsigned step(V& zr, V& zi, V cr, V ci, const Formula& formula) {
+        zr = V::abs(zr);
+        zi = V::abs(zi);
+        return Mandelbrot::step(zr, zi, cr, ci, formula);
+    }
+    static double finish(const Formula& formula, double zr, double zi, double cr, double ci) {
+        return escapeMagnitude<BurningShip>(formula, zr, zi, cr, ci);
+    }
+};
+
+//newton's method on z^3 - 1 from z0 = the point, done once a step moves z by less than 1e-6
+//every point converges, to one of the three roots, so there is nothing to check periodicity for
+struct Newton {
+    static constexpr bool bulbChecks = false;
+    static constexpr bool periodicity = false;
+    static constexpr double tolerance = 1e-12;
+
+    static void start(const Formula&, double x, double y, double& zr, double& zi, double& cr, double& ci) {
+        zr = x;
+        zi = y;
+        cr = ci = 0.0;
+    }
+    //z' = (2 z^3 + 1) / (3 z^2)
+    template<typename V>
+    static unsigned step(V& zr, V& zi, V, V, const Formula&) {
+        V z2r = zr * zr - zi * zi, z2i = (zr + zr) * zi;
+        V z3r = z2r * zr - z2i * zi, z3i = V::fmadd(z2r, zi, z2i * zr);
+        V nr = V::fmadd(V::set1(2.0), z3r, V::set1(1.0)), ni = z3i + z3i;
+        V dr = V::set1(3.0) * z2r, di = V::set1(3.0) * z2i;
+        V inv = V::set1(1.0) / V::fmadd(dr, dr, di * di);
+        V nextR = V::fmadd(nr, dr, ni * di) * inv, nextI = (ni * dr - nr * di) * inv;
+        V mr = nextR - zr, mi = nextI - zi;
+        zr = nextR;
+        zi = nextI;
+        return V::greater(V::set1(tolerance), V::fmadd(mr, mr, mi * mi));
+    }
+    //squared length of the next step, it keeps squaring as z converges
+    static double finish(const Formula& formula, double zr, double zi, double cr, double ci) {
+        VecD1 r{ zr }, i{ zi };
+        step(r, i, VecD1{ cr }, VecD1{ ci }, formula);
+        return (r.v - zr) * (r.v - zr) + (i.v - zi) * (i.v - zi);
+    }
+    static float smooth(const Formula&, size_t n, double move);
+};
+
+}
+
+//calls visit with the policy of the type, adding a formula means a policy and a case here
+template<typename Visitor>
+inline decltype(auto) withFormula(Formula::Type type, Visitor&& visit)
+{
+    switch (type) {
+    case Formula::Type::Julia:
+        return visit(formulas::Julia());
+    case Formula::Type::Multibrot:
+        return visit(formulas::Multibrot());
+    case Formula::Type::BurningShip:
+        return visit(formulas::BurningShip());
+    case Formula::Type::Newton:
+        return visit(formulas::Newton());
+    default:
+        return visit(formulas::Mandelbrot());
+    }
+}
@@ -0,0 +1,320 @@
+#include "imagewriter.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+namespace fs = std::filesystem;
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+        }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    //5552 is the longest run before b could overflow 32 bits
+    while (size > 0) {
+        size_t run = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < run; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+static void putBE32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8)
+        out.push_back(uint8_t(v >> s));
+}
+
+static void putLE(std::vector<uint8_t>& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        out.push_back(uint8_t(v >> (8 * i)));
+}
+
+StreamingImageWriter::StreamingImageWriter(const std::string& path, unsigned width, unsigned height, const std::string& signature)
+    :
+    path_(path),
+    checkpointPath_(path + ".resume"),
+    signature_(signature),
+    width_(width),
+    height_(height)
+{
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(std::tolower((unsigned char)c)); });
+    format_ = ext == ".tif" || ext == ".tiff" ? Format::Tiff : Format::Png;
+
+    //tiles, the offset tables and some room for the directory
+    uint64_t tiles = uint64_t((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+    bigTiff_ = tiles * (uint64_t(tileSize) * tileSize * 3 + 8) + 4096 > 0xFFFFFFFFull;
+
+    if (!resume())
+        start();
+}
+
+bool StreamingImageWriter::resume()
+{
+    std::ifstream checkpoint(checkpointPath_);
+    std::string signature;
+    unsigned rows = 0;
+    uint64_t offset = 0;
+    uint32_t adler = 0;
+    if (!std::getline(checkpoint, signature) || !(checkpoint >> rows >> offset >> adler))
+        return false;
+
+    std::error_code ec;
+    if (signature != signature_ || rows > height_ || fs::file_size(path_, ec) < offset || ec)
+        return false;
+
+    //anything after the last checkpoint belongs to a band that didnt complete
+    fs::resize_file(path_, offset, ec);
+    if (ec)
+        return false;
+    file_.open(path_, std::ios::in | std::ios::out | std::ios::binary);
+    file_.seekp(0, std::ios::end);
+
+    rowsWritten_ = rows;
+    adler_ = adler;
+    return isOpen();
+}
+
+void StreamingImageWriter::start()
+{
+    file_.open(path_, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!isOpen())
+        return;
+
+    rowsWritten_ = 0;
+    adler_ = 1;
+    if (format_ == Format::Png)
+        writePngHeader();
+    else
+        writeTiffHeader();
+    saveCheckpoint();
+}
+
+void StreamingImageWriter::saveCheckpoint()
+{
+    //the data has to be out before the checkpoint points past it
+    file_.flush();
+    uint64_t offset = uint64_t(file_.tellp());
+
+    //written aside and renamed, a crash never leaves a half written checkpoint
+    std::string temporary = checkpointPath_ + ".tmp";
+    {
+        std::ofstream checkpoint(temporary, std::ios::trunc);
+        checkpoint << signature_ << "\n" << rowsWritten_ << " " << offset << " " << adler_ << "\n";
+    }
+    std::error_code ec;
+    fs::rename(temporary, checkpointPath_, ec);
+}
+
+bool StreamingImageWriter::writeRows(const uint8_t* rgb, unsigned rows)
+{
+    if (!isOpen() || rows != std::min(bandHeight, height_ - rowsWritten_) || rows == 0)
+        return false;
+
+    if (format_ == Format::Png)
+        writePngRows(rgb, rows);
+    else
+        writeTiffRows(rgb, rows);
+    rowsWritten_ += rows;
+
+    saveCheckpoint();
+    return isOpen();
+}
+
+bool StreamingImageWriter::finish()
+{
+    if (!isOpen() || rowsWritten_ != height_)
+        return false;
+
+    if (format_ == Format::Png)
+        finishPng();
+    else
+        finishTiff();
+    file_.close();
+
+    std::error_code ec;
+    fs::remove(checkpointPath_, ec);
+    return !file_.fail();
+}
+
+void StreamingImageWriter::writeChunk(const char type[4], const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> chunk;
+    chunk.reserve(data.size() + 12);
+    putBE32(chunk, uint32_t(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    putBE32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    file_.write((const char*)chunk.data(), chunk.size());
+}
+
+void StreamingImageWriter::writePngHeader()
+{
+    const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file_.write((const char*)signature, 8);
+
+    //8 bit rgb, no interlacing
+    std::vector<uint8_t> header;
+    putBE32(header, width_);
+    putBE32(header, height_);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });
+    writeChunk("IHDR", header);
+
+    //zlib header, deflate with a 32k window and no preset dictionary
+    writeChunk("IDAT", { 0x78, 0x01 });
+}
+
+void StreamingImageWriter::writePngRows(const uint8_t* rgb, unsigned rows)
+{
+    //every row starts with its filter type, 0 (none)
+    const size_t stride = size_t(width_) * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve(rows * (stride + 1));
+    for (unsigned y = 0; y < rows; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + y * stride, rgb + (y + 1) * stride);
+    }
+    adler_ = adler32(raw.data(), raw.size(), adler_);
+
+    //stored blocks hold at most 65535 bytes, the final block is only written by finish
+    std::vector<uint8_t> data;
+    data.reserve(raw.size() + raw.size() / 65535 * 5 + 5);
+    for (size_t pos = 0; pos < raw.size(); pos += 65535) {
+        uint16_t len = uint16_t(std::min<size_t>(65535, raw.size() - pos));
+        data.push_back(0);
+        putLE(data, len, 2);
+        putLE(data, uint16_t(~len), 2);
+        data.insert(data.end(), raw.begin() + pos, raw.begin() + pos + len);
+    }
+    writeChunk("IDAT", data);
+}
+
+void StreamingImageWriter::finishPng()
+{
+    //empty final stored block, then the adler-32 of the uncompressed data
+    std::vector<uint8_t> tail = { 0x01, 0x00, 0x00, 0xFF, 0xFF };
+    putBE32(tail, adler_);
+    writeChunk("IDAT", tail);
+    writeChunk("IEND", {});
+}
+
+void StreamingImageWriter::writeTiffHeader()
+{
+    //little endian, the directory offset is filled in by finish
+    std::vector<uint8_t> header = { 'I', 'I' };
+    if (bigTiff_) {
+        putLE(header, 43, 2);
+        putLE(header, 8, 2);
+        putLE(header, 0, 2);
+        putLE(header, 0, 8);
+    }
+    else {
+        putLE(header, 42, 2);
+        putLE(header, 0, 4);
+    }
+    file_.write((const char*)header.data(), header.size());
+}
+
+void StreamingImageWriter::writeTiffRows(const uint8_t* rgb, unsigned rows)
+{
+    //tiles are always full size, the parts past the image edge are padded with black
+    const size_t stride = size_t(width_) * 3;
+    std::vector<uint8_t> tile(size_t(tileSize) * tileSize * 3);
+    for (unsigned x0 = 0; x0 < width_; x0 += tileSize) {
+        std::fill(tile.begin(), tile.end(), 0);
+        unsigned w = std::min(tileSize, width_ - x0);
+        for (unsigned y = 0; y < rows; y++)
+            std::copy_n(rgb + y * stride + size_t(x0) * 3, w * 3, tile.begin() + size_t(y) * tileSize * 3);
+        file_.write((const char*)tile.data(), tile.size());
+    }
+}
+
+void StreamingImageWriter::finishTiff()
+{
+    //tiles were written in order, so their offsets follow from their index
+    const uint64_t tileBytes = uint64_t(tileSize) * tileSize * 3;
+    const uint64_t tiles = uint64_t((width_ + tileSize - 1) / tileSize) * ((height_ + tileSize - 1) / tileSize);
+    const uint64_t ifdOffset = tiffDataStart() + tiles * tileBytes;
+
+    enum : uint16_t { Short = 3, Long = 4, Long8 = 16 };
+    struct Entry {
+        uint16_t tag, type;
+        std::vector<uint64_t> values;
+    };
+    const uint16_t offsetType = bigTiff_ ? Long8 : Long;
+    std::vector<uint64_t> offsets(tiles), counts(tiles, tileBytes);
+    for (uint64_t t = 0; t < tiles; t++)
+        offsets[t] = tiffDataStart() + t * tileBytes;
+
+    const std::vector<Entry> entries = {
+        { 256, Long, { width_ } },
+        { 257, Long, { height_ } },
+        { 258, Short, { 8, 8, 8 } },
+        //no compression, rgb
+        { 259, Short, { 1 } },
+        { 262, Short, { 2 } },
+        { 277, Short, { 3 } },
+        { 284, Short, { 1 } },
+        { 322, Long, { tileSize } },
+        { 323, Long, { tileSize } },
+        { 324, offsetType, offsets },
+        { 325, offsetType, counts }
+    };
+
+    //the directory, then the values too large to fit in their entry
+    const int countBytes = bigTiff_ ? 8 : 2, entryBytes = bigTiff_ ? 20 : 12, fieldBytes = bigTiff_ ? 8 : 4;
+    const uint64_t extraOffset = ifdOffset + countBytes + entries.size() * entryBytes + fieldBytes;
+    std::vector<uint8_t> ifd, extra;
+    putLE(ifd, entries.size(), countBytes);
+    for (const auto& e : entries) {
+        int size = e.type == Short ? 2 : e.type == Long ? 4 : 8;
+        putLE(ifd, e.tag, 2);
+        putLE(ifd, e.type, 2);
+        putLE(ifd, e.values.size(), fieldBytes);
+
+        std::vector<uint8_t> packed;
+        for (uint64_t v : e.values)
+            putLE(packed, v, size);
+        if (packed.size() <= size_t(fieldBytes)) {
+            packed.resize(fieldBytes, 0);
+            ifd.insert(ifd.end(), packed.begin(), packed.end());
+        }
+        else {
+            putLE(ifd, extraOffset + extra.size(), fieldBytes);
+            extra.insert(extra.end(), packed.begin(), packed.end());
+        }
+    }
+    //no next directory
+    putLE(ifd, 0, fieldBytes);
+
+    file_.seekp(std::streamoff(ifdOffset));
+    file_.write((const char*)ifd.data(), ifd.size());
+    file_.write((const char*)extra.data(), extra.size());
+
+    std::vector<uint8_t> pointer;
+    putLE(pointer, ifdOffset, fieldBytes);
+    file_.seekp(bigTiff_ ? 8 : 4);
+    file_.write((const char*)pointer.data(), pointer.size());
+}
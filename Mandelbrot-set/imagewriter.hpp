@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+//writes an rgb image a band of rows at a time, so that only one band is ever in memory
+//png is written with stored (uncompressed) deflate blocks, tiff as uncompressed tiles,
+//switching to bigtiff when the file wouldnt fit 32 bit offsets
+//after every band a checkpoint is saved next to the file, a writer opened on the same file
+//with the same signature continues after the last complete band
+class StreamingImageWriter {
+public:
+    enum class Format { Png, Tiff };
+
+    //format from the extension, .tif / .tiff or png otherwise
+    //signature identifies the render, a checkpoint with a different one is ignored
+    StreamingImageWriter(const std::string& path, unsigned width, unsigned height, const std::string& signature);
+
+    bool isOpen() const { return file_.is_open() && file_.good(); }
+    //rows already in the file, the next band starts there
+    unsigned getRowsWritten() const { return rowsWritten_; }
+    unsigned getBandHeight() const { return bandHeight; }
+    //next band, getBandHeight rows or whatever is left of the image
+    bool writeRows(const uint8_t* rgb, unsigned rows);
+    //completes the file and removes the checkpoint
+    bool finish();
+
+private:
+    bool resume();
+    void start();
+    void saveCheckpoint();
+
+    void writePngHeader();
+    void writePngRows(const uint8_t* rgb, unsigned rows);
+    void finishPng();
+    void writeChunk(const char type[4], const std::vector<uint8_t>& data);
+
+    void writeTiffHeader();
+    void writeTiffRows(const uint8_t* rgb, unsigned rows);
+    void finishTiff();
+    uint64_t tiffDataStart() const { return bigTiff_ ? 16 : 8; }
+
+    std::string path_;
+    std::string checkpointPath_;
+    std::string signature_;
+    Format format_;
+    bool bigTiff_ = false;
+    std::fstream file_;
+
+    unsigned rowsWritten_ = 0;
+    //running adler-32 of the zlib stream of the png
+    uint32_t adler_ = 1;
+
+    //tiles are as high as the bands, so a band is always a whole row of tiles
+    static constexpr unsigned bandHeight = 128;
+    static constexpr unsigned tileSize = bandHeight;
+
+    const unsigned width_;
+    const unsigned height_;
+};
@@ -0,0 +1,105 @@
+#include "kernel.hpp"
+#include "simd.hpp"
+#include "mandelbrot.hpp"
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERNEL_X86
+#endif
+
+using LaneKernel = void (*)(const Formula&, const double*, const double*, const uint32_t*, size_t, size_t, size_t*, double*);
+
+void iterateLanesScalar(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes)
+{
+    iterateFormula<VecD1>(formula, cr, ci, todo, count, maxIter, out, magnitudes);
+}
+
+#ifdef KERNEL_X86
+static bool cpuSupports(bool avx512) {
+#if defined(_MSC_VER)
+    int leaf1[4], leaf7[4];
+    __cpuid(leaf1, 1);
+    __cpuidex(leaf7, 7, 0);
+    //the os also has to save the wider registers on context switches
+    if (!(leaf1[2] & (1 << 27)))
+        return false;
+    unsigned long long xcr0 = _xgetbv(0);
+
+    if (avx512)
+        return (leaf7[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6;
+    bool fma = leaf1[2] & (1 << 12);
+    return (leaf7[1] & (1 << 5)) && fma && (xcr0 & 0x6) == 0x6;
+#else
+    __builtin_cpu_init();
+    if (avx512)
+        return __builtin_cpu_supports("avx512f");
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+struct KernelChoice {
+    LaneKernel kernel;
+    const char* name;
+};
+
+static KernelChoice chooseKernel() {
+#ifdef KERNEL_X86
+    if (cpuSupports(true))
+        return { iterateLanesAvx512, "avx-512 (8 doubles)" };
+    if (cpuSupports(false))
+        return { iterateLanesAvx2, "avx2 (4 doubles)" };
+#endif
+    return { iterateLanesScalar, "scalar" };
+}
+
+static const KernelChoice& kernelChoice() {
+    static const KernelChoice choice = chooseKernel();
+    return choice;
+}
+
+const char* kernelName() {
+    return kernelChoice().name;
+}
+
+void iterateBatch(const double* cr, const double* ci, size_t count, size_t maxIter, size_t* out, float* smooth, 
+    const Formula& formula) 
+{
+    const bool bulbChecks = withFormula(formula.type, [](auto policy) { return decltype(policy)::bulbChecks; });
+
+    //the points settled by the bulb checks dont take a lane
+    thread_local std::vector<uint32_t> todo;
+    todo.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (bulbChecks && cr[i] * cr[i] + ci[i] * ci[i] < 0.005 * 0.005)
+            out[i] = size_t(-1);
+        else if (bulbChecks && inBulbs(cr[i], ci[i]))
+            out[i] = maxIter;
+        else
+            todo.push_back(uint32_t(i));
+    }
+
+    if (!smooth) {
+        kernelChoice().kernel(formula, cr, ci, todo.data(), todo.size(), maxIter, out, nullptr);
+        return;
+    }
+
+    //the logarithms are taken here, the lane kernels stay free of library calls
+    thread_local std::vector<double> magnitudes;
+    magnitudes.resize(count);
+    kernelChoice().kernel(formula, cr, ci, todo.data(), todo.size(), maxIter, out, magnitudes.data());
+    withFormula(formula.type, [&](auto policy) {
+        for (size_t i = 0; i < count; i++) {
+            if (out[i] == size_t(-1))
+                smooth[i] = -1.f;
+            else if (out[i] >= maxIter)
+                smooth[i] = float(maxIter);
+            else
+                smooth[i] = decltype(policy)::smooth(formula, out[i], magnitudes[i]);
+        }
+        });
+}
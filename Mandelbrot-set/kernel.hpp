@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "mandelbrot.hpp"
+#include "formulas.hpp"
+
+//iterates count points at once, out[i] is what diverges(cr[i], ci[i], maxIter) returns
+//the points are spread over the vector lanes of the best instruction set of the cpu
+//smooth, if given, gets the continuous escape counts, maxIter for bounded points and -1 for the disc
+//other formulas than the default mandelbrot one give their own counts, see formulas.hpp
+void iterateBatch(const double* cr, const double* ci, size_t count, size_t maxIter, size_t* out, float* smooth = nullptr,
+    const Formula& formula = Formula());
+//instruction set picked at runtime
+const char* kernelName();
+
+//lane kernels, todo holds the indices of the points left after the bulb checks
+//magnitudes, if given, gets what the finish of the formula gives for the points that are done
+void iterateLanesScalar(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes);
+void iterateLanesAvx2(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes);
+void iterateLanesAvx512(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes);
+
+//shared by the lane kernels, instantiated once per instruction set and formula policy
+//no standard library calls in here, their inline copies could end up compiled for a wider instruction set
+template<typename F, typename V>
+inline void iterateLanes(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes)
+{
+    constexpr int W = V::width;
+    constexpr size_t idle = size_t(-1);
+    alignas(64) double zr[W], zi[W], laneCr[W], laneCi[W];
+    //periodicity checkpoints, same schedule as diverges
+    alignas(64) double savedR[W], savedI[W];
+    size_t lanePoint[W], laneStart[W], laneCheckpoint[W];
+
+    size_t next = 0, step = 0;
+    int active = 0;
+    //idle lanes iterate z = c = 0, which no formula ever gets done with
+    auto refill = [&](int l) {
+        savedR[l] = savedI[l] = 1e10;
+        laneStart[l] = step;
+        laneCheckpoint[l] = step + firstCheckpoint;
+        if (next < count) {
+            lanePoint[l] = todo[next++];
+            F::start(formula, cr[lanePoint[l]], ci[lanePoint[l]], zr[l], zi[l], laneCr[l], laneCi[l]);
+            active++;
+        }
+        else {
+            lanePoint[l] = idle;
+            zr[l] = zi[l] = 0.0;
+            laneCr[l] = laneCi[l] = 0.0;
+        }
+        };
+    //next step at which a lane runs out of iterations or moves its checkpoint
+    auto deadline = [&]() {
+        size_t d = idle;
+        for (int l = 0; l < W; l++) {
+            if (lanePoint[l] == idle)
+                continue;
+            if (laneStart[l] + maxIter < d)
+                d = laneStart[l] + maxIter;
+            if (laneCheckpoint[l] < d)
+                d = laneCheckpoint[l];
+        }
+        return d;
+        };
+
+    for (int l = 0; l < W; l++)
+        refill(l);
+    size_t nextDeadline = deadline();
+
+    V vzr = V::load(zr), vzi = V::load(zi);
+    V vcr = V::load(laneCr), vci = V::load(laneCi);
+    V vsr = V::load(savedR), vsi = V::load(savedI);
+    const V tolerance = V::set1(periodTolerance * periodTolerance);
+
+    while (active > 0) {
+        //for the mandelbrot policy, same iteration as diverges, on every lane
+        unsigned escaped = F::step(vzr, vzi, vcr, vci, formula);
+        step++;
+
+        unsigned periodic = 0;
+        if constexpr (F::periodicity) {
+            V dr = vzr - vsr, di = vzi - vsi;
+            periodic = V::greater(tolerance, V::fmadd(dr, dr, di * di));
+        }
+        if ((escaped | periodic) == 0 && step < nextDeadline)
+            continue;
+
+        //finished points leave their lane to the next point
+        vzr.store(zr);
+        vzi.store(zi);
+        for (int l = 0; l < W; l++) {
+            if (lanePoint[l] == idle)
+                continue;
+
+            size_t n = step - laneStart[l];
+            if (escaped >> l & 1) {
+                out[lanePoint[l]] = n - 1;
+                if (magnitudes)
+                    magnitudes[lanePoint[l]] = F::finish(formula, zr[l], zi[l], laneCr[l], laneCi[l]);
+            }
+            else if ((periodic >> l & 1) || n == maxIter)
+                out[lanePoint[l]] = maxIter;
+            else {
+                if (step == laneCheckpoint[l]) {
+                    savedR[l] = zr[l];
+                    savedI[l] = zi[l];
+                    laneCheckpoint[l] = laneStart[l] + 2 * (step - laneStart[l]);
+                }
+                continue;
+            }
+
+            active--;
+            refill(l);
+        }
+        nextDeadline = deadline();
+        vzr = V::load(zr);
+        vzi = V::load(zi);
+        vcr = V::load(laneCr);
+        vci = V::load(laneCi);
+        vsr = V::load(savedR);
+        vsi = V::load(savedI);
+    }
+}
+
+//lane kernel of the formula of the given type
+template<typename V>
+inline void iterateFormula(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes)
+{
+    withFormula(formula.type, [&](auto policy) {
+        iterateLanes<decltype(policy), V>(formula, cr, ci, todo, count, maxIter, out, magnitudes);
+        });
+}
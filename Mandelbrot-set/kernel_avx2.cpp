@@ -0,0 +1,11 @@
+//compiled with avx2 and fma enabled, only called when the cpu has them
+#include "kernel.hpp"
+#include "simd.hpp"
+
+#ifdef __AVX2__
+void iterateLanesAvx2(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes)
+{
+    iterateFormula<VecD4>(formula, cr, ci, todo, count, maxIter, out, magnitudes);
+}
+#endif
@@ -0,0 +1,11 @@
+//compiled with avx-512 enabled, only called when the cpu has it
+#include "kernel.hpp"
+#include "simd.hpp"
+
+#ifdef __AVX512F__
+void iterateLanesAvx512(const Formula& formula, const double* cr, const double* ci, const uint32_t* todo, 
+    size_t count, size_t maxIter, size_t* out, double* magnitudes)
+{
+    iterateFormula<VecD8>(formula, cr, ci, todo, count, maxIter, out, magnitudes);
+}
+#endif
@@ -1,97 +1,394 @@
 #include <iostream>
 #include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <cstring>
 #include "SFML/Graphics.hpp"
 #include <omp.h>
+#include "profiler.hpp"
+#include "progress.hpp"
+#include "kernel.hpp"
+#include "perturbation.hpp"
+#include "tiles.hpp"
+#include "imagewriter.hpp"
+#include "coloring.hpp"
+#include "antialias.hpp"
+#include "explorer.hpp"
+#include "video.hpp"
+#include "formulas.hpp"
+#include "distributed.hpp"
 #pragma warning(disable: 6993)
 
-static constexpr size_t iter = 5'000;
-static constexpr unsigned int xSize = 4'000;
-static constexpr double colorScale = 1 - 0.7;
+//escape counts saved by an earlier run with the same signature, so that only the coloring runs again
+static bool loadIterations(const std::string& path, const std::string& signature, 
+    std::vector<float>& iterations, Supersamples& supersamples)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string saved(signature.size() + 1, '\0');
+    if (!file || !file.read(saved.data(), saved.size()) || saved != signature + '\n')
+        return false;
 
-inline static bool inBulbs(double x, double y) {
-    //period-2 bulb: center (-1, 0), radius 1/4
-    if ((x + 1) * (x + 1) + y * y < 0.0625 - 0.0025)
-        return true;
+    uint64_t refined = 0;
+    file.read(reinterpret_cast<char*>(iterations.data()), iterations.size() * sizeof(float));
+    file.read(reinterpret_cast<char*>(&refined), sizeof(refined));
+    supersamples.pixels.resize(refined);
+    supersamples.samples.resize(refined * supersamples.perPixel);
+    file.read(reinterpret_cast<char*>(supersamples.pixels.data()), refined * sizeof(size_t));
+    return bool(file.read(reinterpret_cast<char*>(supersamples.samples.data()), supersamples.samples.size() * sizeof(float)));
+}
 
-    //main cardioid
-    double xr = (x - 0.25 + 0.005) * 1.01;
-    double q = xr * xr + y * y;
-    if (q * (q + xr) < 0.25 * y * y * 0.98) 
-        return true;
+static void saveIterations(const std::string& path, const std::string& signature, 
+    const std::vector<float>& iterations, const Supersamples& supersamples)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << signature << '\n';
+    uint64_t refined = supersamples.pixels.size();
+    file.write(reinterpret_cast<const char*>(iterations.data()), iterations.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(&refined), sizeof(refined));
+    file.write(reinterpret_cast<const char*>(supersamples.pixels.data()), refined * sizeof(size_t));
+    file.write(reinterpret_cast<const char*>(supersamples.samples.data()), supersamples.samples.size() * sizeof(float));
+}
 
-    return false;
+//arguments of the local workers of a coordinator, the same options with --worker in place of --coordinator and --spawn
+static std::vector<std::string> workerArguments(int argc, char* argv[], unsigned short port)
+{
+    std::vector<std::string> args = { "--worker", "127.0.0.1", std::to_string(port) };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--coordinator" || arg == "--spawn")
+            i++;
+        else
+            args.push_back(arg);
+    }
+    return args;
 }
 
-inline static size_t diverges(double cr, double ci) {
-    if (cr * cr + ci * ci < 0.005 * 0.005)
-        return size_t(-1);
+//renders and writes a band of rows at a time, resuming after the last band of an interrupted run
+//with the same view and coloring, given by signature
+//with a coordinator the bands come from its workers instead
+static int renderStreamed(const TileRenderer::PixelKernel& kernel, sf::Vector2u imgSize, Colorizer colorizer,
+    bool equalize, int aaSamples, size_t iter, const std::string& output, const std::string& signature,
+    RenderCoordinator* coordinator = nullptr) 
+{
+    StreamingImageWriter writer(output, imgSize.x, imgSize.y, signature);
+    if (!writer.isOpen()) {
+        std::cout << "cannot open " << output << "\n";
+        return -1;
+    }
+    if (writer.getRowsWritten() > 0)
+        std::cout << "resuming from row " << writer.getRowsWritten() << "\n";
 
-    if (inBulbs(cr, ci))
-        return iter;
-        //return size_t(-1);
+    //the bands are colored before the whole image is known, the histogram comes from a coarse preview
+    if (equalize) {
+        constexpr int previewStep = 16;
+        std::vector<double> px, py;
+        for (unsigned y = previewStep / 2; y < imgSize.y; y += previewStep) {
+            for (unsigned x = previewStep / 2; x < imgSize.x; x += previewStep) {
+                px.push_back(x);
+                py.push_back(y);
+            }
+        }
+        std::vector<float> preview(px.size());
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < int(px.size()); i += 1024)
+            kernel(&px[i], &py[i], std::min<size_t>(1024, px.size() - i), &preview[i]);
+        colorizer.equalize(preview.data(), preview.size());
+    }
 
-    double zr = 0.0, zi = 0.0;
-    double zr2 = 0.0, zi2 = 0.0;
+    ProgressReporter progress("render", uint64_t(imgSize.y - writer.getRowsWritten()) * imgSize.x);
+    if (coordinator) {
+        bool rendered = coordinator->run(writer, colorizer, progress);
+        progress.finish();
+        if (!rendered) {
+            std::cout << "cannot write " << output << "\n";
+            return -1;
+        }
+        return writer.finish() ? 0 : -1;
+    }
 
-    for (size_t a = 0; a < iter; ++a) {
-        zi = 2.0 * zr * zi + ci;
-        zr = zr2 - zi2 + cr;
+    WorkStealingPool pool;
+    std::vector<uint8_t> rgb;
+    for (unsigned y0 = writer.getRowsWritten(); y0 < imgSize.y; y0 = writer.getRowsWritten()) {
+        const unsigned rows = std::min(writer.getBandHeight(), imgSize.y - y0);
 
-        zr2 = zr * zr;
-        zi2 = zi * zi;
+        //the renderer sees the band as a whole image
+        TileRenderer::PixelKernel bandKernel = [&](const double* px, const double* py, size_t count, float* out) {
+            thread_local std::vector<double> shifted;
+            shifted.assign(py, py + count);
+            for (auto& y : shifted)
+                y += y0;
+            kernel(px, shifted.data(), count, out);
+            };
+        TileRenderer renderer(imgSize.x, rows, bandKernel);
+        auto iterations = renderer.render(pool, &progress);
+        //edges across the band boundaries are missed, the bands are too tall for it to matter much
+        Supersamples supersamples;
+        if (aaSamples > 0)
+            supersamples = EdgeSupersampler(imgSize.x, rows, iter, aaSamples).refine(iterations.data(), bandKernel);
 
-        if (zr2 + zi2 > 4.0)
-            return a;
+        rgb.resize(iterations.size() * 3);
+        colorizer.apply(iterations.data(), iterations.size(), rgb.data(), 3, &supersamples);
+
+        if (!writer.writeRows(rgb.data(), rows)) {
+            std::cout << "cannot write " << output << "\n";
+            return -1;
+        }
     }
 
-    return iter;
+    progress.finish();
+    return writer.finish() ? 0 : -1;
 }
 
-int main() {
-    double ratio = std::sqrt(7.0) / 3.0;
+//usage: [--deep <real> <imag> <view width>] [--iter <n>] [--width <pixels>] [--output <file>] [--stream] [--explore]
+//       [--palette <ice|fire|gray>] [--equalize] [--iterations <file>] [--aa <samples>]
+//       [--video <end width> <frames per halving>] 
+//       [--formula <mandelbrot|julia|multibrot|ship|newton>] [--julia <real> <imag>] [--degree <d>]
+//       [--coordinator <port> [--spawn <workers>]] [--worker <host> <port>]
+//the deep zoom center is in decimal notation with as many digits as the zoom needs
+//--stream writes the image (png, or tiled tiff for .tif outputs) band by band without holding it in memory,
+//and continues an interrupted run with the same settings
+//--explore opens an interactive viewer instead, drag to pan and scroll to zoom
+//--equalize spreads the palette by the histogram of the escape counts
+//--iterations keeps the escape counts in a file, a later run with the same view only colors them again
+//--aa gives that many extra jittered samples to the pixels on edges
+//--formula switches to another escape-time fractal, --julia sets the constant of the julia set
+//and --degree the power of the multibrot
+//--video zooms on the center from the view width to the end width, in 16:9 frames of the given width,
+//written as numbered images after the output name, or as raw rgb24 to stdout for an output of -
+//--coordinator streams the image from the jobs of worker processes connecting to the port, --spawn starts
+//that many of them on this machine, --worker renders for the coordinator at host, given the same view options
+int main(int argc, char* argv[]) {
+    size_t iter = 5'000;
+    unsigned int xSize = 4'000;
+    std::string output = "image.png";
+    std::string deepRe, deepIm;
     double xView = 3.0;
+    bool stream = false;
+    bool explore = false;
+    bool equalize = false;
+    int aaSamples = 0;
+    double videoEndWidth = 0;
+    int framesPerHalving = 0;
+    Formula formula;
+    std::string iterationsFile;
+    Colorizer::Palette palette = Colorizer::Palette::Ice;
+    unsigned short coordinatorPort = 0;
+    int spawnedWorkers = 0;
+    std::string workerHost;
+    unsigned short workerPort = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--deep" && i + 3 < argc) {
+            deepRe = argv[++i];
+            deepIm = argv[++i];
+            xView = std::stod(argv[++i]);
+        }
+        else if (arg == "--iter" && i + 1 < argc)
+            iter = std::stoull(argv[++i]);
+        else if (arg == "--width" && i + 1 < argc)
+            xSize = std::stoul(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "--stream")
+            stream = true;
+        else if (arg == "--explore")
+            explore = true;
+        else if (arg == "--equalize")
+            equalize = true;
+        else if (arg == "--video" && i + 2 < argc) {
+            videoEndWidth = std::stod(argv[++i]);
+            framesPerHalving = std::stoi(argv[++i]);
+        }
+        else if (arg == "--formula" && i + 1 < argc) {
+            if (!Formula::parse(argv[++i], formula.type))
+                std::cout << "unknown formula " << argv[i] << "\n";
+        }
+        else if (arg == "--julia" && i + 2 < argc) {
+            formula.juliaRe = std::stod(argv[++i]);
+            formula.juliaIm = std::stod(argv[++i]);
+        }
+        else if (arg == "--degree" && i + 1 < argc)
+            formula.degree = std::max(2, std::stoi(argv[++i]));
+        else if (arg == "--aa" && i + 1 < argc)
+            aaSamples = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--iterations" && i + 1 < argc)
+            iterationsFile = argv[++i];
+        else if (arg == "--palette" && i + 1 < argc) {
+            if (!Colorizer::parsePalette(argv[++i], palette))
+                std::cout << "unknown palette " << argv[i] << "\n";
+        }
+        else if (arg == "--coordinator" && i + 1 < argc) {
+            coordinatorPort = (unsigned short)std::stoul(argv[++i]);
+            stream = true;
+        }
+        else if (arg == "--spawn" && i + 1 < argc)
+            spawnedWorkers = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--worker" && i + 2 < argc) {
+            workerHost = argv[++i];
+            workerPort = (unsigned short)std::stoul(argv[++i]);
+        }
+        else
+            std::cout << "unknown option " << arg << "\n";
+    }
+
+    Colorizer colorizer(iter, palette);
+    if (explore) {
+        Explorer explorer({ 1280, 720 }, iter, colorizer, formula);
+        explorer.run();
+        Profiler::exportRequestedTrace();
+        return 0;
+    }
 
+    const bool video = framesPerHalving > 0;
+    //the frames go to stdout, everything else to stderr
+    if (video && output == "-")
+        std::cout.rdbuf(std::cerr.rdbuf());
+
+    double ratio = video ? 9.0 / 16.0 : std::sqrt(7.0) / 3.0;
     sf::Vector2u imgSize(xSize, unsigned(xSize * ratio));
-    sf::Image img({ imgSize.x, imgSize.y }, sf::Color::Black);
 
     //precompute scaling
     double scale = xView / imgSize.x;
-    int midX = imgSize.x / 2;
-    int midY = imgSize.y / 2;
-	int columsCompleted = 0, lastUpdate = 0;
-
-    #pragma omp parallel for schedule(dynamic)
-    for (int x = 0; x < int(imgSize.x); x++) {
-        double cr = (x - midX) * scale - 0.5;
-
-        for (unsigned y = 0; y <= imgSize.y / 2; y++) {
-            double ci = (int(y) - midY) * scale;
-            size_t n = diverges(cr, ci);
-
-            sf::Color c;
-            if (n == size_t(-1))
-                c = sf::Color::Red;
-            else if (n < iter) {
-                double s = std::pow(double(n) / iter, colorScale);
-                uint8_t col = uint8_t(255 * s);
-                c = sf::Color(0, col, col);
+
+    //mirrored images only compute the top half
+    const bool mirrored = deepRe.empty() && !video && formula.isMirrored();
+    const unsigned rows = mirrored ? imgSize.y / 2 + 1 : imgSize.y;
+    const int midX = imgSize.x / 2;
+    const int midY = imgSize.y / 2;
+
+    //points by their offset from the view center
+    ZoomVideo::OffsetKernel offsetKernel;
+    std::unique_ptr<DeepZoom> zoom;
+    double centerRe, centerIm;
+    formula.getDefaultCenter(centerRe, centerIm);
+    if (deepRe.empty()) {
+        std::cout << "kernel: " << kernelName() << "\n";
+        offsetKernel = [&](const double* dx, const double* dy, size_t count, float* out) {
+            thread_local std::vector<double> cr, ci;
+            thread_local std::vector<size_t> n;
+            cr.resize(count);
+            ci.resize(count);
+            n.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                cr[i] = dx[i] + centerRe;
+                ci[i] = dy[i] + centerIm;
             }
-            else
-                c = sf::Color::White;
+            iterateBatch(cr.data(), ci.data(), count, iter, n.data(), out, formula);
+            };
+    }
+    else {
+        if (formula.type != Formula::Type::Mandelbrot) {
+            std::cout << "deep zooms only support the mandelbrot formula\n";
+            return -1;
+        }
+        //the frames of a video all share the reference of the first one, precise enough for the last one
+        zoom = std::make_unique<DeepZoom>(deepRe, deepIm, xView / 2, xView * ratio / 2, scale, iter, video ? videoEndWidth / 2 : 0);
+        std::cout << "reference: " << zoom->getReferenceLength() << " iterations, skipping " << 
+            zoom->getSkippedIterations() << "\n";
 
-            img.setPixel({ unsigned(x), y }, c);
-            img.setPixel({ unsigned(x), imgSize.y - y - 1 }, c);
+        offsetKernel = [&](const double* dx, const double* dy, size_t count, float* out) {
+            for (size_t i = 0; i < count; i++)
+                zoom->iterate(dx[i], dy[i], &out[i]);
+            };
+    }
+
+    if (video) {
+        if (equalize)
+            std::cout << "--equalize is ignored for videos, the colors would flicker from keyframe to keyframe\n";
+        ZoomVideo zoomVideo(offsetKernel, imgSize, xView, videoEndWidth, framesPerHalving, colorizer, iter, aaSamples);
+        int result = zoomVideo.render(output);
+        Profiler::exportRequestedTrace();
+        return result;
+    }
+
+    TileRenderer::PixelKernel kernel = [&](const double* px, const double* py, size_t count, float* out) {
+        thread_local std::vector<double> dx, dy;
+        dx.resize(count);
+        dy.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            dx[i] = (px[i] - midX) * scale;
+            dy[i] = (py[i] - midY) * scale;
         }
-        columsCompleted++;
+        offsetKernel(dx.data(), dy.data(), count, out);
+        };
 
-        #pragma omp critical
-        if (int(50.0 * columsCompleted / imgSize.x) > int(50.0 * lastUpdate / imgSize.x)) {
-            std::cout << 100.0 * columsCompleted / imgSize.x << "%\n";
-            lastUpdate = columsCompleted;
+    std::ostringstream signature;
+    signature << std::setprecision(17) << imgSize.x << " " << iter << " " << xView << " " << deepRe << " " << deepIm << " " << aaSamples << 
+        " " << int(formula.type) << " " << formula.juliaRe << " " << formula.juliaIm << " " << formula.degree;
+    //the escape counts dont depend on the coloring, a partly written image does
+    const std::string imageSignature = signature.str() + " " + std::to_string(int(palette)) + " " + (equalize ? "1" : "0");
+    if (!workerHost.empty()) {
+        RenderWorker worker(workerHost, workerPort, signature.str());
+        if (!worker.isConnected()) {
+            std::cout << "cannot connect to " << workerHost << ":" << workerPort << "\n";
+            return -1;
+        }
+        return worker.run(kernel, iter, aaSamples) ? 0 : -1;
+    }
+    if (coordinatorPort > 0) {
+        RenderCoordinator coordinator(coordinatorPort, imgSize, aaSamples, signature.str());
+        if (!coordinator.isListening()) {
+            std::cout << "cannot listen on port " << coordinatorPort << "\n";
+            return -1;
         }
+        LocalWorkers workers(argv[0], workerArguments(argc, argv, coordinatorPort), spawnedWorkers);
+        int result = renderStreamed(kernel, imgSize, colorizer, equalize, aaSamples, iter, output, imageSignature, &coordinator);
+        Profiler::exportRequestedTrace();
+        return result;
+    }
+    if (stream) {
+        int result = renderStreamed(kernel, imgSize, colorizer, equalize, aaSamples, iter, output, imageSignature);
+        Profiler::exportRequestedTrace();
+        return result;
+    }
+
+    std::vector<float> iterations(size_t(imgSize.x) * rows);
+    Supersamples supersamples;
+    supersamples.perPixel = aaSamples;
+    if (!iterationsFile.empty() && loadIterations(iterationsFile, signature.str(), iterations, supersamples))
+        std::cout << "escape counts loaded from " << iterationsFile << "\n";
+    else {
+        WorkStealingPool pool;
+        TileRenderer renderer(imgSize.x, rows, kernel);
+        ProgressReporter progress("render", iterations.size());
+        iterations = renderer.render(pool, &progress);
+        progress.finish();
+        std::cout << "iterated " << 100.0 * renderer.getIteratedPixels() / iterations.size() << 
+            "% of the pixels, " << pool.getSteals() << " tiles stolen\n";
+
+        if (aaSamples > 0) {
+            supersamples = EdgeSupersampler(imgSize.x, rows, iter, aaSamples).refine(iterations.data(), kernel);
+            std::cout << "supersampled " << 100.0 * supersamples.pixels.size() / iterations.size() << "% of the pixels\n";
+        }
+        if (!iterationsFile.empty())
+            saveIterations(iterationsFile, signature.str(), iterations, supersamples);
+    }
+
+    if (equalize)
+        colorizer.equalize(iterations.data(), iterations.size());
+    std::vector<uint8_t> pixels(size_t(imgSize.x) * imgSize.y * 4);
+    colorizer.apply(iterations.data(), iterations.size(), pixels.data(), 4, &supersamples);
+
+    //the bottom half is the top one upside down, the middle rows are computed either way
+    const size_t rowBytes = size_t(imgSize.x) * 4;
+    if (mirrored) {
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < int(rows); y++)
+            if (imgSize.y - y - 1 >= rows)
+                std::memcpy(&pixels[(imgSize.y - y - 1) * rowBytes], &pixels[y * rowBytes], rowBytes);
+    }
+    sf::Image img({ imgSize.x, imgSize.y }, pixels.data());
+
+    {
+        PROFILE_SCOPE("save");
+        auto _ = img.saveToFile(output);
     }
 
-    std::cout << "100.0%\n";
-    auto _ = img.saveToFile("image.png");
+    Profiler::exportRequestedTrace();
     return 0;
 }
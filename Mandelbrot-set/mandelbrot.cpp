@@ -0,0 +1,61 @@
+#include "mandelbrot.hpp"
+#include <cmath>
+#include <algorithm>
+
+bool inBulbs(double x, double y) {
+    //period-2 bulb: center (-1, 0), radius 1/4
+    if ((x + 1) * (x + 1) + y * y < 0.0625 - 0.0025)
+        return true;
+
+    //main cardioid
+    double xr = (x - 0.25 + 0.005) * 1.01;
+    double q = xr * xr + y * y;
+    if (q * (q + xr) < 0.25 * y * y * 0.98) 
+        return true;
+
+    return false;
+}
+
+size_t diverges(double cr, double ci, size_t maxIter) {
+    if (cr * cr + ci * ci < 0.005 * 0.005)
+        return size_t(-1);
+
+    if (inBulbs(cr, ci))
+        return maxIter;
+        //return size_t(-1);
+
+    double zr = 0.0, zi = 0.0;
+    double zr2 = 0.0, zi2 = 0.0;
+    //the orbit never gets back to 0 before the first checkpoint, unless c is a center
+    double savedR = 1e10, savedI = 1e10;
+    size_t checkpoint = firstCheckpoint;
+
+    for (size_t a = 0; a < maxIter; ++a) {
+        zi = 2.0 * zr * zi + ci;
+        zr = zr2 - zi2 + cr;
+
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+
+        if (zr2 + zi2 > 4.0)
+            return a;
+
+        double dr = zr - savedR, di = zi - savedI;
+        if (dr * dr + di * di < periodTolerance * periodTolerance)
+            return maxIter;
+        if (a + 1 == checkpoint) {
+            savedR = zr;
+            savedI = zi;
+            checkpoint *= 2;
+        }
+    }
+
+    return maxIter;
+}
+
+float smoothIterations(size_t n, double magnitude, int degree) {
+    //log2 |z| gets multiplied by the degree with every iteration once |z| is large
+    double mu = double(n + 1 + smoothExtraIterations) - std::log2(0.5 * std::log2(magnitude)) / std::log2(double(degree));
+    //the approximation can stray a little out of the band, keeping it in keeps the integer count
+    return float(std::clamp(mu, double(n), n + 0.999));
+}
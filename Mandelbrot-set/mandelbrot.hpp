@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+//true inside the main cardioid or the period-2 bulb, slightly shrunk to be safe
+bool inBulbs(double x, double y);
+//iteration at which the orbit of c escapes, maxIter if it doesnt,
+//size_t(-1) marks the small disc around the origin
+size_t diverges(double cr, double ci, size_t maxIter);
+
+//continuous escape count for coloring, from the integer count n and |z|^2 once the orbit went
+//smoothExtraIterations further past the escape, the escape radius of 2 alone is too small for a smooth result
+//it falls from n + 1 for orbits that barely escaped to n for the ones that escaped by far,
+//so neighbouring bands join continuously
+//degree is the power of z in the formula
+float smoothIterations(size_t n, double magnitude, int degree = 2);
+constexpr int smoothExtraIterations = 3;
+
+//periodicity checks, brent style: the orbit is compared against a checkpoint that moves
+//to the current point after 16, 32, 64, ... iterations, so any cycle shorter than the window is caught
+//an orbit back within periodTolerance of its checkpoint is taken as bounded
+constexpr size_t firstCheckpoint = 16;
+constexpr double periodTolerance = 1e-13;
@@ -0,0 +1,159 @@
+#include "perturbation.hpp"
+#include "mandelbrot.hpp"
+#include "profiler.hpp"
+#include <cmath>
+#include <algorithm>
+
+DeepZoom::DeepZoom(const std::string& centerRe, const std::string& centerIm, 
+    double halfWidth, double halfHeight, double pixelSize, size_t maxIter, double finestHalfWidth)
+    :
+    maxIter_(maxIter)
+{
+    //a pixel is about halfWidth / 1000, the reference needs to resolve well below that
+    int limbs = BigFloat::limbsFor((finestHalfWidth > 0 ? std::min(halfWidth, finestHalfWidth) : halfWidth) * 1e-3);
+    computeReference(BigFloat::fromString(centerRe, limbs), BigFloat::fromString(centerIm, limbs));
+    computeSeries(std::hypot(halfWidth, halfHeight), pixelSize);
+    validateSeries(halfWidth, halfHeight);
+}
+
+void DeepZoom::computeReference(const BigFloat& cr, const BigFloat& ci)
+{
+    PROFILE_SCOPE("DeepZoom::computeReference");
+    BigFloat zr(cr.getFractionLimbs()), zi(cr.getFractionLimbs());
+    zr_.assign(1, 0.0);
+    zi_.assign(1, 0.0);
+
+    for (size_t n = 0; n < maxIter_; n++) {
+        BigFloat zr2 = zr * zr, zi2 = zi * zi, zri = zr * zi;
+        zi = zri + zri + ci;
+        zr = zr2 - zi2 + cr;
+
+        double r = zr.toDouble(), i = zi.toDouble();
+        zr_.push_back(r);
+        zi_.push_back(i);
+        //a bit past the escape radius, the pixels near the reference escape later than it
+        if (r * r + i * i > 1e6)
+            break;
+    }
+}
+
+void DeepZoom::computeSeries(double maxDelta, double pixelSize)
+{
+    PROFILE_SCOPE("DeepZoom::computeSeries");
+    const double d3 = maxDelta * maxDelta * maxDelta;
+    std::complex<double> a = 0.0, b = 0.0, c = 0.0;
+    a_.assign(1, a);
+    b_.assign(1, b);
+    c_.assign(1, c);
+
+    for (size_t n = 0; n + 1 < zr_.size(); n++) {
+        //from dz' = 2 Z dz + dz^2 + dc
+        std::complex<double> z(zr_[n], zi_[n]);
+        std::complex<double> nextA = 2.0 * z * a + 1.0;
+        std::complex<double> nextB = 2.0 * z * b + a * a;
+        std::complex<double> nextC = 2.0 * z * c + 2.0 * a * b;
+
+        //a pixel has grown to about |A| pixelSize by now, the last term kept bounds the ones cut off
+        if (std::abs(nextC) * d3 > seriesTolerance * std::abs(nextA) * pixelSize)
+            break;
+        //the orbit gets close to escaping, offsets wont stay small
+        if (std::norm(z) > 4.0)
+            break;
+
+        a = nextA;
+        b = nextB;
+        c = nextC;
+        a_.push_back(a);
+        b_.push_back(b);
+        c_.push_back(c);
+    }
+
+    skip_ = a_.size() - 1;
+}
+
+void DeepZoom::validateSeries(double halfWidth, double halfHeight)
+{
+    PROFILE_SCOPE("DeepZoom::validateSeries");
+    //corners and middles of the edges, where the offsets are the largest
+    std::vector<std::complex<double>> probes;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+            if (x != 0 || y != 0)
+                probes.emplace_back(x * halfWidth, y * halfHeight);
+
+    std::vector<size_t> exact;
+    for (const auto& p : probes)
+        exact.push_back(iterateFrom(p, 0));
+
+    while (skip_ > 0) {
+        bool agrees = true;
+        for (size_t p = 0; p < probes.size() && agrees; p++)
+            agrees = iterateFrom(probes[p], skip_) == exact[p];
+        if (agrees)
+            break;
+        skip_ /= 2;
+    }
+}
+
+size_t DeepZoom::iterate(double dcr, double dci, float* smooth) const
+{
+    if (!smooth)
+        return iterateFrom({ dcr, dci }, skip_);
+
+    double magnitude = 0.0;
+    size_t n = iterateFrom({ dcr, dci }, skip_, &magnitude);
+    *smooth = n < maxIter_ ? smoothIterations(n, magnitude) : float(maxIter_);
+    return n;
+}
+
+size_t DeepZoom::iterateFrom(std::complex<double> dc, size_t skip, double* magnitude) const
+{
+    const double dcr = dc.real(), dci = dc.imag();
+    //past the escape the offset doesnt matter anymore, z is iterated directly with c = Z_1 + dc
+    auto escape = [&](double zr, double zi) {
+        if (magnitude) {
+            for (int e = 0; e < smoothExtraIterations; e++) {
+                double t = zr * zr - zi * zi + zr_[1] + dcr;
+                zi = 2.0 * zr * zi + zi_[1] + dci;
+                zr = t;
+            }
+            *magnitude = zr * zr + zi * zi;
+        }
+        };
+    std::complex<double> dz = ((c_[skip] * dc + b_[skip]) * dc + a_[skip]) * dc;
+    double dzr = dz.real(), dzi = dz.imag();
+
+    //n counts the iterations of the pixel, m indexes the reference
+    size_t m = skip;
+    for (size_t n = skip; n < maxIter_; n++) {
+        double zr = zr_[m] + dzr, zi = zi_[m] + dzi;
+        double mag = zr * zr + zi * zi;
+        if (mag > 4.0) {
+            escape(zr, zi);
+            return n - 1;
+        }
+
+        //rebase when the pixel gets closer to 0 than its offset (where the offset would lose precision),
+        //or when the reference escaped
+        if (mag < dzr * dzr + dzi * dzi || m + 1 >= zr_.size()) {
+            dzr = zr;
+            dzi = zi;
+            m = 0;
+        }
+
+        //dz' = (2 Z + dz) dz + dc
+        double tr = 2.0 * zr_[m] + dzr, ti = 2.0 * zi_[m] + dzi;
+        double nextR = tr * dzr - ti * dzi + dcr;
+        double nextI = tr * dzi + ti * dzr + dci;
+        dzr = nextR;
+        dzi = nextI;
+        m++;
+    }
+
+    //same as diverges, an orbit still bounded after maxIter returns maxIter
+    double zr = zr_[m] + dzr, zi = zi_[m] + dzi;
+    if (zr * zr + zi * zi <= 4.0)
+        return maxIter_;
+    escape(zr, zi);
+    return maxIter_ - 1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <complex>
+#include "bigfloat.hpp"
+
+//deep zoom by perturbation theory
+//the orbit of the center is computed once in high precision, every pixel then iterates
+//in doubles its offset from that orbit, rebasing on the orbit start when the offset gets too large
+class DeepZoom {
+public:
+    //center in decimal notation, halfWidth and halfHeight give the extent of the image, pixelSize its resolution
+    //finestHalfWidth sets the precision when narrower views share the reference, like the frames of a zoom
+    DeepZoom(const std::string& centerRe, const std::string& centerIm, 
+        double halfWidth, double halfHeight, double pixelSize, size_t maxIter, double finestHalfWidth = 0);
+
+    //same result as diverges for the point at offset (dcr, dci) from the center,
+    //smooth gets the continuous escape count like iterateBatch gives it
+    size_t iterate(double dcr, double dci, float* smooth = nullptr) const;
+    //iterations every pixel skips thanks to the series approximation
+    size_t getSkippedIterations() const { return skip_; }
+    size_t getReferenceLength() const { return zr_.size(); }
+
+private:
+    void computeReference(const BigFloat& cr, const BigFloat& ci);
+    //series coefficients while the truncated terms stay negligible for the whole image
+    void computeSeries(double maxDelta, double pixelSize);
+    //lowers the skip until the probes at the image border agree with full iteration
+    void validateSeries(double halfWidth, double halfHeight);
+    //magnitude, if given, gets |z|^2 smoothExtraIterations past the escape
+    size_t iterateFrom(std::complex<double> dc, size_t skip, double* magnitude = nullptr) const;
+
+    //reference orbit rounded to doubles, from z0 = 0 until it escapes or hits the limit
+    std::vector<double> zr_, zi_;
+    //dz_n ~ A_n dc + B_n dc^2 + C_n dc^3
+    std::vector<std::complex<double>> a_, b_, c_;
+    size_t skip_ = 0;
+    const size_t maxIter_;
+
+    //largest error of the series at the image border, as a fraction of a pixel carried along the orbit
+    static constexpr double seriesTolerance = 1e-3;
+};
@@ -0,0 +1,77 @@
+#include "scheduler.hpp"
+
+thread_local int WorkStealingPool::currentWorker_ = -1;
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+    for (unsigned i = 0; i < std::max(1u, threads); i++)
+        workers_.push_back(std::make_unique<Worker>());
+}
+
+void WorkStealingPool::run(std::vector<Task> tasks)
+{
+    steals_ = 0;
+    pending_ = tasks.size();
+    //initial tasks are dealt round robin
+    for (size_t t = 0; t < tasks.size(); t++)
+        workers_[t % workers_.size()]->tasks.push_back(std::move(tasks[t]));
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < workers_.size(); i++)
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    workerLoop(0);
+
+    for (auto& t : threads)
+        t.join();
+}
+
+void WorkStealingPool::spawn(Task task)
+{
+    //counted before it becomes visible, so that pending never drops to 0 early
+    pending_++;
+    auto& worker = *workers_[currentWorker_];
+    std::lock_guard lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+}
+
+void WorkStealingPool::workerLoop(unsigned index)
+{
+    currentWorker_ = int(index);
+    Task task;
+    while (pending_ > 0) {
+        if (popOrSteal(index, task)) {
+            task();
+            task = nullptr;
+            pending_--;
+        }
+        else
+            std::this_thread::yield();
+    }
+    currentWorker_ = -1;
+}
+
+bool WorkStealingPool::popOrSteal(unsigned index, Task& task)
+{
+    {
+        auto& own = *workers_[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    //the oldest tasks of the others are the largest ones
+    for (size_t i = 1; i < workers_.size(); i++) {
+        auto& victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals_++;
+            return true;
+        }
+    }
+    return false;
+}
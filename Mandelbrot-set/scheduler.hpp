@@ -0,0 +1,44 @@
+#pragma once
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <thread>
+
+//threads with a deque of tasks each, a thread takes the newest task of its own deque
+//and steals the oldest task of another one when its own is empty
+//tasks can spawn more tasks, they go on the deque of the thread running them
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency());
+
+    //runs the tasks and everything they spawn on all the threads, the calling one included
+    void run(std::vector<Task> tasks);
+    //only valid from inside a task
+    void spawn(Task task);
+
+    unsigned getThreadCount() const { return unsigned(workers_.size()); }
+    //tasks taken from another thread during the last run
+    size_t getSteals() const { return steals_; }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    bool popOrSteal(unsigned index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    //queued or running tasks, the run ends when it drops to 0
+    std::atomic<size_t> pending_ = 0;
+    std::atomic<size_t> steals_ = 0;
+
+    //index of the worker the current thread runs, -1 outside of run
+    static thread_local int currentWorker_;
+};
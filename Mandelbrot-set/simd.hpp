@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+//minimal vectors of doubles for the escape-time kernel
+//each one is only defined in the translation units compiled for its instruction set
+
+struct VecD1 {
+    static constexpr int width = 1;
+    double v;
+
+    static VecD1 load(const double* p) { return { *p }; }
+    static VecD1 set1(double x) { return { x }; }
+    void store(double* p) const { *p = v; }
+
+    friend VecD1 operator+(VecD1 a, VecD1 b) { return { a.v + b.v }; }
+    friend VecD1 operator-(VecD1 a, VecD1 b) { return { a.v - b.v }; }
+    friend VecD1 operator*(VecD1 a, VecD1 b) { return { a.v * b.v }; }
+    friend VecD1 operator/(VecD1 a, VecD1 b) { return { a.v / b.v }; }
+    static VecD1 abs(VecD1 a) { return { a.v < 0.0 ? -a.v : a.v }; }
+    //a * b + c
+    static VecD1 fmadd(VecD1 a, VecD1 b, VecD1 c) { return { a.v * b.v + c.v }; }
+    //bit i set if lane i of a is greater than lane i of b
+    static unsigned greater(VecD1 a, VecD1 b) { return a.v > b.v; }
+};
+
+#ifdef __AVX2__
+struct VecD4 {
+    static constexpr int width = 4;
+    __m256d v;
+
+    static VecD4 load(const double* p) { return { _mm256_load_pd(p) }; }
+    static VecD4 set1(double x) { return { _mm256_set1_pd(x) }; }
+    void store(double* p) const { _mm256_store_pd(p, v); }
+
+    friend VecD4 operator+(VecD4 a, VecD4 b) { return { _mm256_add_pd(a.v, b.v) }; }
+    friend VecD4 operator-(VecD4 a, VecD4 b) { return { _mm256_sub_pd(a.v, b.v) }; }
+    friend VecD4 operator*(VecD4 a, VecD4 b) { return { _mm256_mul_pd(a.v, b.v) }; }
+    friend VecD4 operator/(VecD4 a, VecD4 b) { return { _mm256_div_pd(a.v, b.v) }; }
+    static VecD4 abs(VecD4 a) { return { _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v) }; }
+    static VecD4 fmadd(VecD4 a, VecD4 b, VecD4 c) { return { _mm256_fmadd_pd(a.v, b.v, c.v) }; }
+    static unsigned greater(VecD4 a, VecD4 b) {
+        return unsigned(_mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)));
+    }
+};
+#endif
+
+#ifdef __AVX512F__
+struct VecD8 {
+    static constexpr int width = 8;
+    __m512d v;
+
+    static VecD8 load(const double* p) { return { _mm512_load_pd(p) }; }
+    static VecD8 set1(double x) { return { _mm512_set1_pd(x) }; }
+    void store(double* p) const { _mm512_store_pd(p, v); }
+
+    friend VecD8 operator+(VecD8 a, VecD8 b) { return { _mm512_add_pd(a.v, b.v) }; }
+    friend VecD8 operator-(VecD8 a, VecD8 b) { return { _mm512_sub_pd(a.v, b.v) }; }
+    friend VecD8 operator*(VecD8 a, VecD8 b) { return { _mm512_mul_pd(a.v, b.v) }; }
+    friend VecD8 operator/(VecD8 a, VecD8 b) { return { _mm512_div_pd(a.v, b.v) }; }
+    static VecD8 abs(VecD8 a) { return { _mm512_abs_pd(a.v) }; }
+    static VecD8 fmadd(VecD8 a, VecD8 b, VecD8 c) { return { _mm512_fmadd_pd(a.v, b.v, c.v) }; }
+    static unsigned greater(VecD8 a, VecD8 b) {
+        return unsigned(_mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ));
+    }
+};
+#endif
@@ -0,0 +1,103 @@
+#include "tiles.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+
+TileRenderer::TileRenderer(unsigned width, unsigned height, PixelKernel kernel)
+    :
+    kernel_(std::move(kernel)),
+    width_(width),
+    height_(height)
+{
+}
+
+std::vector<float> TileRenderer::render(WorkStealingPool& pool, ProgressReporter* progress, std::vector<float> seed)
+{
+    progress_ = progress;
+    if (seed.size() == size_t(width_) * height_)
+        iterations_ = std::move(seed);
+    else
+        iterations_.assign(size_t(width_) * height_, unknown);
+    iterated_ = 0;
+
+    std::vector<WorkStealingPool::Task> tasks;
+    for (int y = 0; y < int(height_); y += rootTileSize) {
+        for (int x = 0; x < int(width_); x += rootTileSize) {
+            Tile tile{ x, y, std::min(x + rootTileSize, int(width_)), std::min(y + rootTileSize, int(height_)) };
+            tasks.push_back([this, &pool, tile] { renderTile(pool, tile); });
+        }
+    }
+    pool.run(std::move(tasks));
+
+    return std::move(iterations_);
+}
+
+void TileRenderer::renderTile(WorkStealingPool& pool, Tile tile)
+{
+    PROFILE_SCOPE("tile");
+    const int w = tile.x1 - tile.x0, h = tile.y1 - tile.y0;
+    computePixels(tile, true);
+    if (w <= 2 || h <= 2)
+        return;
+
+    //the border pixels are known, check if they all agree
+    const float first = iterations_[size_t(tile.y0) * width_ + tile.x0];
+    bool isUniform = true;
+    for (int x = tile.x0; x < tile.x1 && isUniform; x++)
+        isUniform = iterations_[size_t(tile.y0) * width_ + x] == first && iterations_[size_t(tile.y1 - 1) * width_ + x] == first;
+    for (int y = tile.y0; y < tile.y1 && isUniform; y++)
+        isUniform = iterations_[size_t(y) * width_ + tile.x0] == first && iterations_[size_t(y) * width_ + tile.x1 - 1] == first;
+
+    if (isUniform) {
+        for (int y = tile.y0 + 1; y < tile.y1 - 1; y++)
+            std::fill_n(iterations_.begin() + size_t(y) * width_ + tile.x0 + 1, w - 2, first);
+        if (progress_)
+            progress_->add(size_t(w - 2) * (h - 2));
+        return;
+    }
+
+    if (w <= minTileSize || h <= minTileSize) {
+        computePixels(tile, false);
+        return;
+    }
+
+    //the quarters share the outer border with this tile, only the cross in the middle is new
+    const int xm = tile.x0 + w / 2, ym = tile.y0 + h / 2;
+    const Tile quarters[4] = {
+        { tile.x0, tile.y0, xm, ym }, { xm, tile.y0, tile.x1, ym },
+        { tile.x0, ym, xm, tile.y1 }, { xm, ym, tile.x1, tile.y1 }
+    };
+    for (int q = 1; q < 4; q++)
+        pool.spawn([this, &pool, t = quarters[q]] { renderTile(pool, t); });
+    renderTile(pool, quarters[0]);
+}
+
+void TileRenderer::computePixels(const Tile& tile, bool borderOnly)
+{
+    thread_local std::vector<double> px, py;
+    thread_local std::vector<float> out;
+    px.clear();
+    py.clear();
+
+    for (int y = tile.y0; y < tile.y1; y++) {
+        bool isBorderRow = y == tile.y0 || y == tile.y1 - 1;
+        for (int x = tile.x0; x < tile.x1; x++) {
+            if (borderOnly && !isBorderRow && x != tile.x0 && x != tile.x1 - 1)
+                continue;
+            if (iterations_[size_t(y) * width_ + x] != unknown)
+                continue;
+            px.push_back(x);
+            py.push_back(y);
+        }
+    }
+    if (px.empty())
+        return;
+
+    out.resize(px.size());
+    kernel_(px.data(), py.data(), px.size(), out.data());
+    for (size_t i = 0; i < px.size(); i++)
+        iterations_[size_t(py[i]) * width_ + size_t(px[i])] = out[i];
+
+    iterated_ += px.size();
+    if (progress_)
+        progress_->add(px.size());
+}
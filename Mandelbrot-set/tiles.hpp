@@ -0,0 +1,51 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <atomic>
+#include "scheduler.hpp"
+#include "progress.hpp"
+
+//mariani-silver rendering: a tile whose border has a single iteration count is filled whole,
+//otherwise it is split in 4 and each quarter is handled the same way
+//this relies on the set being connected
+//the counts are continuous, so in practice only tiles of bounded points are filled,
+//escaping ones would need their exact fractional counts anyway
+class TileRenderer {
+public:
+    //fills out with the continuous escape counts of count points, given by their coordinates in the image
+    //in pixels, the renderer only asks for whole pixels, the antialiasing for points between them
+    using PixelKernel = std::function<void(const double* px, const double* py, size_t count, float* out)>;
+
+    TileRenderer(unsigned width, unsigned height, PixelKernel kernel);
+
+    //escape counts of every pixel, row by row
+    //progress, if given, gets the pixels as they are done
+    //seed holds counts already known from elsewhere, unknown for the pixels to compute
+    std::vector<float> render(WorkStealingPool& pool, ProgressReporter* progress = nullptr, std::vector<float> seed = {});
+    //pixels that went through the kernel instead of being filled
+    size_t getIteratedPixels() const { return iterated_; }
+
+    //marks the pixels not computed yet
+    static constexpr float unknown = -2.f;
+
+private:
+    struct Tile {
+        int x0, y0, x1, y1;
+    };
+
+    void renderTile(WorkStealingPool& pool, Tile tile);
+    //iterates the pixels of the tile that arent known yet, only the border if borderOnly
+    void computePixels(const Tile& tile, bool borderOnly);
+
+    std::vector<float> iterations_;
+    PixelKernel kernel_;
+    std::atomic<size_t> iterated_ = 0;
+    ProgressReporter* progress_ = nullptr;
+
+    static constexpr int rootTileSize = 64;
+    //tiles this small are iterated whole instead of split again
+    static constexpr int minTileSize = 8;
+
+    const unsigned width_;
+    const unsigned height_;
+};
@@ -0,0 +1,157 @@
+#include "video.hpp"
+#include "antialias.hpp"
+#include "scheduler.hpp"
+#include "profiler.hpp"
+#include "progress.hpp"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+ZoomVideo::ZoomVideo(OffsetKernel kernel, sf::Vector2u frameSize, double startWidth, double endWidth, 
+    int framesPerHalving, const Colorizer& colorizer, size_t maxIter, int aaSamples)
+    :
+    kernel_(std::move(kernel)),
+    colorizer_(colorizer),
+    frameSize_(frameSize.x & ~1u, frameSize.y & ~1u),
+    keySize_(2 * frameSize_.x, 2 * frameSize_.y),
+    startWidth_(startWidth),
+    framesPerHalving_(std::max(1, framesPerHalving)),
+    maxIter_(maxIter),
+    aaSamples_(aaSamples)
+{
+    double halvings = std::max(0.0, std::log2(startWidth / endWidth));
+    frames_ = size_t(std::ceil(halvings * framesPerHalving_)) + 1;
+}
+
+int ZoomVideo::render(const std::string& output)
+{
+    std::FILE* pipe = nullptr;
+    if (output == "-") {
+        pipe = stdout;
+#if defined(_WIN32)
+        auto _ = _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+
+    int keyframe = -1;
+    ProgressReporter progress("frames", frames_, std::cerr);
+    for (size_t f = 0; f < frames_; f++) {
+        //frame f is 2^(f / framesPerHalving) times narrower than the first one
+        const double halvings = double(f) / framesPerHalving_;
+        const int k = int(std::floor(halvings));
+        while (keyframe < k)
+            renderKeyframe(++keyframe);
+
+        frame_.resize(size_t(frameSize_.x) * frameSize_.y * (pipe ? 3 : 4));
+        resample(std::exp2(-(halvings - k)), frame_.data(), pipe ? 3 : 4);
+        if (!writeFrame(output, f, pipe)) {
+            std::cerr << "cannot write frame " << f << "\n";
+            return -1;
+        }
+        progress.add(1);
+    }
+    progress.finish();
+
+    std::cerr << "iterated " << double(iteratedPixels_) / (double(frames_) * frameSize_.x * frameSize_.y) << 
+        " samples per frame pixel over " << keyframe + 1 << " keyframes\n";
+    return 0;
+}
+
+void ZoomVideo::renderKeyframe(int index)
+{
+    PROFILE_SCOPE("ZoomVideo::renderKeyframe");
+    const unsigned kw = keySize_.x, kh = keySize_.y;
+    const int midX = kw / 2, midY = kh / 2;
+    const double pixel = startWidth_ * std::exp2(-index) / kw;
+
+    //pixel (x, y) of this keyframe is pixel (x / 2 + w / 4, y / 2 + h / 4) of the previous one when x and y are even,
+    //the grids line up since the middles are even too
+    std::vector<float> seed(size_t(kw) * kh, TileRenderer::unknown);
+    if (!keyIterations_.empty()) {
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < int(kh); y += 2)
+            for (unsigned x = 0; x < kw; x += 2)
+                seed[size_t(y) * kw + x] = keyIterations_[size_t(y / 2 + midY / 2) * kw + x / 2 + midX / 2];
+    }
+
+    TileRenderer::PixelKernel pixelKernel = [&](const double* px, const double* py, size_t count, float* out) {
+        thread_local std::vector<double> dx, dy;
+        dx.resize(count);
+        dy.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            dx[i] = (px[i] - midX) * pixel;
+            dy[i] = (py[i] - midY) * pixel;
+        }
+        kernel_(dx.data(), dy.data(), count, out);
+        };
+
+    WorkStealingPool pool;
+    TileRenderer renderer(kw, kh, pixelKernel);
+    keyIterations_ = renderer.render(pool, nullptr, std::move(seed));
+    iteratedPixels_ += renderer.getIteratedPixels();
+
+    Supersamples supersamples;
+    if (aaSamples_ > 0) {
+        supersamples = EdgeSupersampler(kw, kh, maxIter_, aaSamples_).refine(keyIterations_.data(), pixelKernel);
+        iteratedPixels_ += supersamples.samples.size();
+    }
+
+    keyColors_.resize(keyIterations_.size() * 3);
+    colorizer_.apply(keyIterations_.data(), keyIterations_.size(), keyColors_.data(), 3, &supersamples);
+}
+
+void ZoomVideo::resample(double scale, uint8_t* pixels, int channels) const
+{
+    PROFILE_SCOPE("ZoomVideo::resample");
+    const int kw = int(keySize_.x), kh = int(keySize_.y);
+    //a frame pixel spans 2 * scale keyframe pixels, between 1 and 2
+    const double step = 2.0 * scale;
+
+    auto bilinear = [&](double u, double v, int c) {
+        u = std::clamp(u, 0.0, kw - 1.001);
+        v = std::clamp(v, 0.0, kh - 1.001);
+        const int x = int(u), y = int(v);
+        const double fx = u - x, fy = v - y;
+        const uint8_t* p = &keyColors_[(size_t(y) * kw + x) * 3 + c];
+        const size_t row = size_t(kw) * 3;
+        return (p[0] * (1 - fx) + p[3] * fx) * (1 - fy) + (p[row] * (1 - fx) + p[row + 3] * fx) * fy;
+        };
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < int(frameSize_.y); y++) {
+        const double v = kh / 2 + (y - int(frameSize_.y) / 2) * step;
+        for (unsigned x = 0; x < frameSize_.x; x++) {
+            const double u = kw / 2 + (int(x) - int(frameSize_.x) / 2) * step;
+            uint8_t* p = pixels + (size_t(y) * frameSize_.x + x) * channels;
+            //four taps across the footprint, a box filter for the shrinking
+            const double d = step / 4;
+            for (int c = 0; c < 3; c++) {
+                double sum = bilinear(u - d, v - d, c) + bilinear(u + d, v - d, c) + 
+                    bilinear(u - d, v + d, c) + bilinear(u + d, v + d, c);
+                p[c] = uint8_t(sum / 4 + 0.5);
+            }
+            if (channels == 4)
+                p[3] = 255;
+        }
+    }
+}
+
+bool ZoomVideo::writeFrame(const std::string& output, size_t index, std::FILE* pipe)
+{
+    PROFILE_SCOPE("ZoomVideo::writeFrame");
+    if (pipe)
+        return std::fwrite(frame_.data(), 1, frame_.size(), pipe) == frame_.size() && std::fflush(pipe) == 0;
+
+    const size_t dot = output.find_last_of('.');
+    std::ostringstream path;
+    path << output.substr(0, dot) << "_" << std::setw(5) << std::setfill('0') << index << 
+        (dot == std::string::npos ? ".png" : output.substr(dot));
+    sf::Image image(frameSize_, frame_.data());
+    return image.saveToFile(path.str());
+}
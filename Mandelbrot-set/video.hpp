@@ -0,0 +1,49 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "coloring.hpp"
+#include "tiles.hpp"
+
+//zoom sequence towards the view center, each keyframe halves the view width of the previous one
+//and is rendered at twice the frame size, the frames in between are resampled from it
+//a keyframe covers the middle half of the previous one, every other pixel of its grid lands
+//exactly on a pixel of the previous keyframe, so a quarter of its samples are already known
+class ZoomVideo {
+public:
+    //fills out with the escape counts of count points, given by their offset from the view center
+    using OffsetKernel = std::function<void(const double* dx, const double* dy, size_t count, float* out)>;
+
+    //frameSize is rounded down to even sizes, framesPerHalving frames go by every time the width halves
+    ZoomVideo(OffsetKernel kernel, sf::Vector2u frameSize, double startWidth, double endWidth, 
+        int framesPerHalving, const Colorizer& colorizer, size_t maxIter, int aaSamples);
+
+    //output "-" writes raw rgb24 frames to stdout, anything else gets numbered images next to it,
+    //image.png giving image_00000.png, image_00001.png, ...
+    int render(const std::string& output);
+    size_t getFrameCount() const { return frames_; }
+
+private:
+    //counts and colors of the keyframe, from the counts of the previous one
+    void renderKeyframe(int index);
+    //frame whose view is scale times the keyframe width, into rgb with channels per pixel
+    void resample(double scale, uint8_t* pixels, int channels) const;
+    bool writeFrame(const std::string& output, size_t index, std::FILE* pipe);
+
+    OffsetKernel kernel_;
+    const Colorizer& colorizer_;
+    sf::Vector2u frameSize_;
+    sf::Vector2u keySize_;
+    double startWidth_;
+    int framesPerHalving_;
+    size_t frames_;
+    size_t maxIter_;
+    int aaSamples_;
+
+    std::vector<float> keyIterations_;
+    std::vector<uint8_t> keyColors_;
+    std::vector<uint8_t> frame_;
+    size_t iteratedPixels_ = 0;
+};
@@ -1,4 +1,5 @@
 #include "lbm.hpp"
+#include "profiler.hpp"
 
 LBM::LBM()
 {
@@ -65,6 +66,7 @@ void LBM::applyOutletSimple()
 
 void LBM::step()
 {
+	PROFILE_SCOPE("LBM::step");
 	//collision (write post-collision into ftmp)
     #pragma omp parallel for
     for (int y = 0; y < NY; y++) {
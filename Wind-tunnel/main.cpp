@@ -1,8 +1,10 @@
 #include <iostream>
 #include "foil.hpp"
 #include "lbm.hpp"
+#include "profiler.hpp"
 
 sf::Image generateImg(LBM& lbm, bool drawSolid) {
+	PROFILE_SCOPE("generateImg");
 	sf::Image img(sf::Vector2u(NX, NY));
 	bool vorticity = sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Space);
 
@@ -95,6 +97,7 @@ int main() {
 	int fps = 0;
 
 	while (window.isOpen()) {
+		PROFILE_SCOPE("frame");
 		while(auto e = window.pollEvent()) {
 			if (e->is<sf::Event::Closed>())
 				window.close();
@@ -118,7 +121,10 @@ int main() {
 		window.draw(foil.upperFoil);
 		window.draw(foil.lowerFoil);
 		
-		window.display();
+		{
+			PROFILE_SCOPE("display");
+			window.display();
+		}
 
 		auto f = lbm.performSteps(10);
 
@@ -131,5 +137,6 @@ int main() {
 		}
 	}
 
+	Profiler::exportRequestedTrace();
 	return 0;
 }
\ No newline at end of file